@@ -0,0 +1,267 @@
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "arena.hpp"
+#include "ast.hpp"
+#include "bench.hpp"
+#include "gc.hpp"
+#include "symbol.hpp"
+
+// The former nodes: an open hierarchy dispatched through virtual type() and
+// reduce(), where applications find their arrow with dynamic_cast. The
+// reduction is otherwise the same as AST::App::reduce.
+namespace virt {
+
+using AST::Type;
+
+struct Node;
+struct App;
+struct Arrow;
+
+struct Call {
+	const App* app;
+	const Arrow* arrow;
+	size_t base;
+	size_t next;
+};
+
+struct Env {
+	std::vector<const Node*> globals;
+	std::vector<const Node*> stack;
+	size_t frame = 0;
+	std::vector<Call> calls;
+	Heap heap;
+
+	const Node* lookup(SymbolId sym) const {
+		return sym < globals.size() ? globals[sym] : nullptr;
+	}
+
+	void define(SymbolId sym, const Node* val) {
+		if (sym >= globals.size()) globals.resize(sym + 1, nullptr);
+		globals[sym] = val;
+	}
+
+	const Node* arg(size_t slot) const { return stack[frame + slot]; }
+};
+
+struct Node {
+	virtual Type type() const = 0;
+	virtual bool is_leaf() const = 0;
+	virtual const Node* reduce(Env& env) const = 0;
+};
+
+struct Branch : Node {
+	std::span<Node*> children;
+
+	bool is_leaf() const override { return false; }
+};
+
+struct Leaf : Node {
+	bool is_leaf() const override { return true; }
+	const Node* reduce(Env&) const override { return this; }
+};
+
+struct Arrow : Branch {
+	Type type() const override { return Type::Arrow; }
+	virtual std::span<Node* const> arg_list() const = 0;
+};
+
+struct Builtin : Arrow {
+	using Func = const Node* (*)(Env& env);
+
+	Func impl;
+
+	Builtin(Func impl, std::span<Node*> params) : impl {impl} {
+		children = params;
+	}
+	const Node* reduce(Env& env) const override { return impl(env); }
+	std::span<Node* const> arg_list() const override { return children; }
+};
+
+struct Number : Leaf {
+	int64_t val;
+
+	Number(int64_t num) : val {num} {}
+	Type type() const override { return Type::Number; }
+};
+
+struct Symbol : Leaf {
+	SymbolId id;
+
+	Symbol(const char* val) : id {intern(val)} {}
+	Type type() const override { return Type::Symbol; }
+};
+
+struct Error : Leaf {
+	Type type() const override { return Type::Error; }
+};
+
+struct App : Branch {
+	Type type() const override { return Type::App; }
+
+	const Node* enter(Env& env, const Node*& res) const {
+		const Node* fst = children[0];
+		if (fst->type() != Type::Symbol) {
+			res = env.heap.make<Error>();
+			return nullptr;
+		}
+		const Node* sym_val = env.lookup(dynamic_cast<const Symbol*>(fst)->id);
+		if (sym_val == nullptr || sym_val->type() != Type::Arrow) {
+			res = env.heap.make<Error>();
+			return nullptr;
+		}
+		const Arrow* arrow = dynamic_cast<const Arrow*>(sym_val);
+		if (children.size() - 1 != arrow->arg_list().size()) {
+			res = env.heap.make<Error>();
+			return nullptr;
+		}
+		env.calls.push_back(Call {this, arrow, env.stack.size(), 1});
+		return children[1];
+	}
+
+	const Node* reduce(Env& env) const override {
+		const size_t floor = env.calls.size();
+		const Node* next = this;
+		const Node* val = nullptr;
+		while (true) {
+			while (next != nullptr) {
+				if (next->type() == Type::App) {
+					next = dynamic_cast<const App*>(next)->enter(env, val);
+				} else {
+					val = next->reduce(env);
+					next = nullptr;
+				}
+			}
+
+			if (env.calls.size() == floor) return val;
+			Call& call = env.calls.back();
+			if (val->type() == Type::Error) {
+				env.stack.resize(call.base);
+				env.calls.pop_back();
+				continue;
+			}
+			env.stack.push_back(val);
+			if (++call.next < call.app->children.size()) {
+				next = call.app->children[call.next];
+				continue;
+			}
+
+			const Call done = call;
+			const size_t caller = env.frame;
+			env.frame = done.base;
+			val = done.arrow->reduce(env);
+			env.frame = caller;
+			env.stack.resize(done.base);
+			env.calls.pop_back();
+
+			if (env.heap.due())
+				env.heap.collect([&](Heap& heap) {
+					for (auto node : env.stack) heap.mark(node);
+					heap.mark(val);
+				});
+		}
+	}
+};
+
+#define DEF_BINARY_OP(FUNC, CHECK)                      \
+	const Node* FUNC(Env& env) {                          \
+		auto x = (const Number*)env.arg(0);                 \
+		auto y = (const Number*)env.arg(1);                 \
+		int64_t res;                                        \
+		if (CHECK(x->val, y->val, &res))                    \
+			return env.heap.make<Error>();                   \
+		return env.heap.make<Number>(res);                 \
+	}
+
+DEF_BINARY_OP(add, __builtin_add_overflow);
+DEF_BINARY_OP(sub, __builtin_sub_overflow);
+DEF_BINARY_OP(mul, __builtin_mul_overflow);
+
+#undef DEF_BINARY_OP
+
+struct Ops {
+	Arena arena;
+	Env env;
+
+	Ops() {
+		const char* names[] = {"+", "-", "*"};
+		Builtin::Func impls[] = {add, sub, mul};
+		for (size_t i = 0; i < 3; i++) {
+			auto params = arena.array<Node*>(2);
+			params[0] = arena.make<Symbol>("x");
+			params[1] = arena.make<Symbol>("y");
+			env.define(intern(names[i]), arena.make<Builtin>(impls[i], params));
+		}
+	}
+};
+
+} // namespace virt
+
+// Builds the same trees out of either kind of node
+template<typename Node, typename App, typename Number, typename Symbol>
+struct Trees {
+	static App* app(Arena& arena, const char* op, Node* x, Node* y) {
+		auto res = arena.make<App>();
+		res->children = arena.array<Node*>(3);
+		res->children[0] = arena.make<Symbol>(op);
+		res->children[1] = x;
+		res->children[2] = y;
+		return res;
+	}
+
+	// balanced tree of binary calls to + - and *
+	static Node* calls(Arena& arena, size_t depth, size_t& n) {
+		static const char* ops[] = {"+", "-", "*"};
+		if (depth == 0) return arena.make<Number>((int64_t)1);
+		n++;
+		Node* x = calls(arena, depth - 1, n);
+		Node* y = calls(arena, depth - 1, n);
+		return app(arena, ops[depth % 3], x, y);
+	}
+
+	// right-leaning chain of binary calls to + and -
+	static Node* chain(Arena& arena, size_t depth) {
+		static const char* ops[] = {"+", "-"};
+		Node* res = arena.make<Number>((int64_t)0);
+		for (size_t i = 0; i < depth; i++)
+			res = app(arena, ops[i % 2], arena.make<Number>((int64_t)(i % 9 + 1)), res);
+		return res;
+	}
+};
+
+using VirtTrees = Trees<virt::Node, virt::App, virt::Number, virt::Symbol>;
+using TaggedTrees = Trees<AST::Node, AST::App, AST::Number, AST::Symbol>;
+
+static constexpr size_t calls_depth = 14;
+static constexpr size_t chain_depth = 100000;
+
+BENCH(ast_calls_virtual) {
+	virt::Ops ops;
+	size_t n = 0;
+	const virt::Node* root = VirtTrees::calls(ops.arena, calls_depth, n);
+	for (auto _ : st) bench::keep(root->reduce(ops.env));
+	st.set_items((double)n);
+}
+
+BENCH(ast_calls_tagged) {
+	AST::AST ast;
+	size_t n = 0;
+	const AST::Node* root = TaggedTrees::calls(ast.arena, calls_depth, n);
+	for (auto _ : st) bench::keep(root->reduce(ast.env));
+	st.set_items((double)n);
+}
+
+BENCH(ast_chain_virtual) {
+	virt::Ops ops;
+	const virt::Node* root = VirtTrees::chain(ops.arena, chain_depth);
+	for (auto _ : st) bench::keep(root->reduce(ops.env));
+	st.set_items((double)chain_depth);
+}
+
+BENCH(ast_chain_tagged) {
+	AST::AST ast;
+	const AST::Node* root = TaggedTrees::chain(ast.arena, chain_depth);
+	for (auto _ : st) bench::keep(root->reduce(ast.env));
+	st.set_items((double)chain_depth);
+}
@@ -0,0 +1,88 @@
+#ifndef ALUAR_BENCH_HPP
+#define ALUAR_BENCH_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Minimal self-contained benchmark harness. A benchmark is a function taking
+// a State, doing its setup and then timing the body of a range-for over it:
+//
+//   BENCH(name) {
+//     setup();
+//     for (auto _ : st) work();
+//   }
+namespace bench {
+
+// number of calls to the global operator new since startup
+uint64_t allocations();
+
+// Factor of the size of scaled workloads, set with --scale
+double scale();
+inline size_t scaled(size_t n) {
+	const double res = (double)n * scale();
+	return res < 1 ? 1 : (size_t)res;
+}
+
+struct State {
+	size_t iterations;
+
+	std::chrono::steady_clock::duration elapsed {};
+	uint64_t allocs {};
+	// work done per iteration, reported as a rate
+	double items {};
+	double bytes {};
+
+	// non-trivial, so that the unused loop variable does not warn
+	struct Tick {
+		Tick() {}
+		~Tick() {}
+	};
+
+	struct Iterator {
+		State *st;
+		size_t left;
+
+		bool operator!=(const Iterator &) const {
+			if (left != 0) return true;
+			st->stop();
+			return false;
+		}
+		void operator++() { left--; }
+		Tick operator*() const { return Tick {}; }
+	};
+
+	Iterator begin();
+	Iterator end();
+
+	void set_items(double n) { items = n; }
+	void set_bytes(double n) { bytes = n; }
+
+ private:
+	std::chrono::steady_clock::time_point start;
+	uint64_t start_allocs {};
+	void stop();
+};
+
+using Func = void(State &);
+
+struct Registrar {
+	Registrar(const char *name, Func *fn);
+};
+
+// keep the compiler from optimizing away a computed value
+template<typename T>
+inline void keep(const T &val) {
+	asm volatile("" : : "r,m"(val) : "memory");
+}
+
+} // namespace bench
+
+#define BENCH(NAME)                                     \
+	static void NAME(bench::State &st);                   \
+	static bench::Registrar NAME##_registrar(#NAME, NAME); \
+	static void NAME(bench::State &st)
+
+#endif
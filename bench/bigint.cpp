@@ -0,0 +1,64 @@
+#include <string>
+
+#include "bench.hpp"
+#include "bigint.hpp"
+#include "eval.hpp"
+#include "lex.hpp"
+#include "parse.hpp"
+#include "workload.hpp"
+
+static BigInt digits(size_t n) {
+	std::string src;
+	for (size_t i = 0; i < n; i++) src += (char)('1' + i * 7 % 9);
+	BigInt res;
+	BigInt::parse(src, res);
+	return res;
+}
+
+// arithmetic that never leaves the int64_t fast path
+BENCH(arith_small) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(12, nodes);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	for (auto _ : st) bench::keep(eval(tree, src));
+	st.set_items((double)nodes);
+}
+
+// every product overflows, so everything after runs on bigints
+BENCH(arith_promoted) {
+	std::string src = "(mul";
+	for (size_t i = 0; i < 64; i++) src += " 9223372036854775807";
+	src += ")";
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	for (auto _ : st) bench::keep(eval(tree, src));
+	st.set_items(64);
+}
+
+#define MUL_BENCH(DIGITS)                          \
+	BENCH(bigint_mul_##DIGITS) {                     \
+		const BigInt a = digits(DIGITS);               \
+		const BigInt b = digits(DIGITS);               \
+		for (auto _ : st) bench::keep((a * b).mag.size()); \
+	}
+
+// below and above the Karatsuba threshold of 32 limbs, about 600 digits
+MUL_BENCH(100)
+MUL_BENCH(500)
+MUL_BENCH(2000)
+MUL_BENCH(10000)
+
+#undef MUL_BENCH
+
+BENCH(bigint_div_2000) {
+	const BigInt a = digits(4000);
+	const BigInt b = digits(2000);
+	for (auto _ : st) bench::keep((a / b).mag.size());
+}
+
+BENCH(bigint_print_10000) {
+	const BigInt a = digits(10000);
+	for (auto _ : st) bench::keep(a.to_string().size());
+	st.set_bytes(10000);
+}
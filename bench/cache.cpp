@@ -0,0 +1,45 @@
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "cache.hpp"
+#include "eval.hpp"
+#include "lex.hpp"
+#include "parse.hpp"
+#include "workload.hpp"
+
+static const std::string small_src = "(add (mul 2 3) (sub 10 4) (xor 7 1))";
+
+// what a lookup saves
+BENCH(cache_small_uncached) {
+	for (auto _ : st) {
+		auto tks = tokenize(small_src);
+		const auto tree = parse(tks, small_src);
+		bench::keep(eval(tree, small_src));
+	}
+	st.set_bytes((double)small_src.size());
+}
+
+BENCH(cache_small_hit) {
+	ProgramCache cache;
+	for (auto _ : st) bench::keep(cache.get(small_src)->run(false));
+	st.set_bytes((double)small_src.size());
+}
+
+BENCH(cache_arith_tree_hit) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(12, nodes);
+	ProgramCache cache({.compile = true});
+	for (auto _ : st) bench::keep(cache.get(src)->run(true));
+	st.set_items((double)nodes);
+}
+
+// a working set larger than the bound, so every lookup misses and evicts
+BENCH(cache_thrash) {
+	std::vector<std::string> srcs;
+	for (size_t i = 0; i < 256; i++) srcs.push_back("(add " + std::to_string(i) + " 1)");
+	ProgramCache cache({.max_bytes = 16 << 10});
+	for (auto _ : st)
+		for (auto &src : srcs) bench::keep(cache.get(src)->run(false));
+	st.set_items((double)srcs.size());
+}
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Compares two runs of aluar_bench --json and flags regressions.
+
+    bench/compare.py OLD.json NEW.json [--threshold 0.10]
+
+A benchmark regressed if its time per iteration grew by more than the
+threshold, or if it allocates more per iteration. Exits with 1 if any did.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    return (
+        data.get("scale"),
+        data.get("threads"),
+        {b["name"]: b for b in data["benchmarks"]},
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("old")
+    parser.add_argument("new")
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=0.10,
+        help="relative change in time that counts, 0.10 by default",
+    )
+    args = parser.parse_args()
+
+    old_scale, old_threads, old = load(args.old)
+    new_scale, new_threads, new = load(args.new)
+    if old_scale != new_scale:
+        print(f"warning: scales differ, {old_scale} against {new_scale}")
+    if old_threads != new_threads:
+        print(f"warning: hardware threads differ, {old_threads} against {new_threads}")
+
+    regressions = 0
+    print(f"{'benchmark':40} {'old ns/it':>14} {'new ns/it':>14} {'change':>8}")
+    for name in sorted(old.keys() & new.keys()):
+        o, n = old[name], new[name]
+        change = n["ns_per_it"] / o["ns_per_it"] - 1 if o["ns_per_it"] > 0 else 0
+        notes = []
+        regressed = False
+        if change > args.threshold:
+            notes.append("REGRESSION")
+            regressed = True
+        elif change < -args.threshold:
+            notes.append("improved")
+        # allocations are exact, any growth is a change in behavior
+        if n["allocs_per_it"] > o["allocs_per_it"] + 0.5:
+            notes.append(
+                f"ALLOCS {o['allocs_per_it']:.2f} -> {n['allocs_per_it']:.2f}"
+            )
+            regressed = True
+        regressions += regressed
+        print(
+            f"{name:40} {o['ns_per_it']:14.1f} {n['ns_per_it']:14.1f} "
+            f"{change * 100:+7.1f}% {' '.join(notes)}"
+        )
+
+    for name in sorted(old.keys() - new.keys()):
+        print(f"{name:40} only in {args.old}")
+    for name in sorted(new.keys() - old.keys()):
+        print(f"{name:40} only in {args.new}")
+
+    print(f"{regressions} regression(s) past {args.threshold * 100:.0f}%")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,111 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+#include "ast.hpp"
+#include "bench.hpp"
+#include "symbol.hpp"
+
+// The former environment: a map from symbol names to values, where calls
+// bind their parameters by name and erase them afterwards. Arguments are all
+// reduced before binding, since binding them one at a time isn't re-entrant.
+namespace legacy {
+
+using Env = std::map<std::string, const AST::Node*>;
+using Func = const AST::Node* (*)(Env& env);
+
+struct Builtin : AST::Leaf {
+	Func impl;
+	std::vector<std::string> params;
+
+	Builtin(Func impl) : AST::Leaf(AST::Type::Arrow), impl {impl}, params {"x", "y"} {}
+};
+
+#define DEF_BINARY_OP(FUNC, OP)                         \
+	const AST::Node* FUNC(Env& env) {                     \
+		auto x = (const AST::Number*)env[std::string("x")]; \
+		auto y = (const AST::Number*)env[std::string("y")]; \
+		return new AST::Number(x->val OP y->val);           \
+	}
+
+DEF_BINARY_OP(add, +);
+DEF_BINARY_OP(sub, -);
+DEF_BINARY_OP(mul, *);
+
+#undef DEF_BINARY_OP
+
+const AST::Node* reduce(const AST::Node* node, Env& env) {
+	if (node->type() != AST::Type::App) return node;
+	auto app = (const AST::App*)node;
+	auto head = (const AST::Symbol*)app->children[0];
+	auto fn = (const Builtin*)env[std::string(symbol_name(head->id))];
+
+	std::vector<const AST::Node*> args;
+	for (size_t i = 1; i < app->children.size(); i++)
+		args.push_back(reduce(app->children[i], env));
+	for (size_t i = 0; i < args.size(); i++) env[fn->params[i]] = args[i];
+	const AST::Node* ret = fn->impl(env);
+	for (auto& param : fn->params) env.erase(env.find(param));
+	return ret;
+}
+
+} // namespace legacy
+
+// balanced tree of binary calls to + - and *
+static AST::Node* calls(Arena& arena, size_t depth, size_t& calls) {
+	static const char* ops[] = {"+", "-", "*"};
+	if (depth == 0) return arena.make<AST::Number>((int64_t)(depth % 7));
+	calls++;
+	auto app = arena.make<AST::App>();
+	app->children = arena.array<AST::Node*>(3);
+	app->children[0] = arena.make<AST::Symbol>(ops[depth % 3]);
+	app->children[1] = ::calls(arena, depth - 1, calls);
+	app->children[2] = ::calls(arena, depth - 1, calls);
+	return app;
+}
+
+BENCH(env_calls_frames) {
+	AST::AST ast;
+	size_t n = 0;
+	const AST::Node* root = calls(ast.arena, 12, n);
+	for (auto _ : st) bench::keep(root->reduce(ast.env));
+	st.set_items((double)n);
+}
+
+BENCH(env_calls_map) {
+	Arena arena;
+	legacy::Env env;
+	legacy::Builtin add(legacy::add), sub(legacy::sub), mul(legacy::mul);
+	env["+"] = &add;
+	env["-"] = &sub;
+	env["*"] = &mul;
+	size_t n = 0;
+	const AST::Node* root = calls(arena, 12, n);
+	for (auto _ : st) bench::keep(legacy::reduce(root, env));
+	st.set_items((double)n);
+}
+
+// right-leaning chain of depth binary calls to + and -
+static AST::Node* chain(Arena& arena, size_t depth) {
+	static const char* ops[] = {"+", "-"};
+	AST::Node* res = arena.make<AST::Number>((int64_t)0);
+	for (size_t i = 0; i < depth; i++) {
+		auto app = arena.make<AST::App>();
+		app->children = arena.array<AST::Node*>(3);
+		app->children[0] = arena.make<AST::Symbol>(ops[i % 2]);
+		app->children[1] = arena.make<AST::Number>((int64_t)(i % 9 + 1));
+		app->children[2] = res;
+		res = app;
+	}
+	return res;
+}
+
+// a million nested calls, reduced without recursing
+BENCH(env_deep_chain) {
+	AST::AST ast;
+	const size_t depth = 1000000;
+	const AST::Node* root = chain(ast.arena, depth);
+	for (auto _ : st) bench::keep(root->reduce(ast.env));
+	st.set_items((double)depth);
+}
@@ -0,0 +1,57 @@
+#include <string>
+
+#include "bench.hpp"
+#include "eval.hpp"
+#include "lex.hpp"
+#include "parse.hpp"
+#include "pool.hpp"
+#include "workload.hpp"
+
+BENCH(eval_add) {
+	const std::string src = "(add 2 2)";
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	for (auto _ : st) bench::keep(eval(tree, src));
+	st.set_items(4);
+}
+
+BENCH(eval_arith_tree) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(12, nodes);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	for (auto _ : st) bench::keep(eval(tree, src));
+	st.set_items((double)nodes);
+}
+
+BENCH(eval_cat) {
+	const std::string src = "(cat \"foo\" (cat \"bar\" \"baz\"))";
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	for (auto _ : st) bench::keep(eval(tree, src));
+	st.set_items(7);
+}
+
+// Wide application of heavy subtrees, evaluated by a pool of the given size.
+// Scaling is bounded by the hardware threads, which runs report, as a pool
+// larger than them only adds the cost of its tasks.
+static void eval_wide(bench::State &st, size_t jobs) {
+	size_t nodes = 0;
+	const std::string src = bench::wide_tree(64, 12, nodes);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	Pool pool(jobs);
+	for (auto _ : st) bench::keep(eval(tree, src, pool));
+	st.set_items((double)nodes);
+}
+
+#define WIDE_BENCH(JOBS) \
+	BENCH(eval_wide_jobs_##JOBS) { eval_wide(st, JOBS); }
+
+WIDE_BENCH(1)
+WIDE_BENCH(2)
+WIDE_BENCH(4)
+WIDE_BENCH(8)
+WIDE_BENCH(16)
+
+#undef WIDE_BENCH
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "ast.hpp"
+#include "bench.hpp"
+#include "eval.hpp"
+#include "gc.hpp"
+#include "lex.hpp"
+#include "parse.hpp"
+#include "vm.hpp"
+
+// a string long enough to be linked instead of copied, and a big number
+static const std::string soak_src =
+	"(cat \"the quick brown fox jumps over \" (cat \"the lazy dog, \" "
+	"\"again and again and again and again\"))"
+	"(add (mul 99999999999 99999999999 99999999999) 1)";
+
+static constexpr size_t soak_evals = 1 << 20;
+
+// Memory must stay flat however many evaluations run, so the peak of live
+// bytes is reported next to the total allocated
+static void report(const char *name, const Heap &heap, size_t peak, size_t evals) {
+	const auto &s = heap.stats();
+	fprintf(
+		stderr,
+		"; %s: %zu evaluations, %zu bytes allocated, %zu peak live, "
+		"%zu collections (%zu minor), %.3f ms max pause\n",
+		name,
+		evals,
+		s.allocated,
+		peak,
+		s.collections,
+		s.minor_collections,
+		(double)s.max_pause_ns / 1e6
+	);
+}
+
+// runs each top-level form of soak_src through run, a million times over
+template<typename Run>
+static void soak(
+	bench::State &st, const char *name, Run run, size_t nursery = Heap::Options {}.nursery
+) {
+	Heap heap({.threshold = 1 << 20, .nursery = nursery});
+	Heap *prev = set_value_heap(&heap);
+	TokenStream tks(soak_src);
+	std::vector<CST> forms;
+	std::vector<std::string> texts;
+	CST tree;
+	while (parse_form(tks, tree)) {
+		forms.push_back(tree);
+		texts.emplace_back(tks.text());
+	}
+	size_t peak = 0, evals = 0;
+	for (auto _ : st)
+		for (size_t i = 0; i < soak_evals; i++) {
+			const size_t f = i % forms.size();
+			bench::keep(run(forms[f], texts[f]));
+			peak = std::max(peak, heap.stats().bytes);
+			evals++;
+		}
+	st.set_items((double)soak_evals);
+	set_value_heap(prev);
+	report(name, heap, peak, evals);
+}
+
+BENCH(gc_soak_eval) {
+	soak(st, "gc_soak_eval", [](const CST &tree, const std::string &src) {
+		return eval(tree, src);
+	});
+}
+
+// the same with full collections only
+BENCH(gc_soak_eval_full) {
+	soak(
+		st,
+		"gc_soak_eval_full",
+		[](const CST &tree, const std::string &src) { return eval(tree, src); },
+		0
+	);
+}
+
+BENCH(gc_soak_vm) {
+	Bytecode code;
+	soak(st, "gc_soak_vm", [&code](const CST &tree, const std::string &src) {
+		code = compile(tree, src);
+		return run(code);
+	});
+}
+
+// reductions of the AST, whose results are numbers allocated in its heap
+BENCH(gc_soak_ast) {
+	AST::AST ast;
+	auto app = ast.arena.make<AST::App>();
+	app->children = ast.arena.array<AST::Node*>(3);
+	app->children[0] = ast.arena.make<AST::Symbol>("+");
+	app->children[1] = ast.arena.make<AST::Number>((int64_t)1);
+	app->children[2] = ast.arena.make<AST::Number>((int64_t)2);
+	size_t peak = 0, evals = 0;
+	for (auto _ : st)
+		for (size_t i = 0; i < soak_evals; i++) {
+			bench::keep(app->reduce(ast.env));
+			peak = std::max(peak, ast.heap.stats().bytes);
+			evals++;
+		}
+	st.set_items((double)soak_evals);
+	report("gc_soak_ast", ast.heap, peak, evals);
+}
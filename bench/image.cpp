@@ -0,0 +1,50 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "bench.hpp"
+#include "cache.hpp"
+#include "image.hpp"
+#include "io.hpp"
+#include "workload.hpp"
+
+// a big script on disk, along with its image
+struct ImagedFile {
+	std::filesystem::path src_path;
+	std::filesystem::path img_path;
+	SourceStamp stamp {};
+	size_t nodes = 0;
+
+	ImagedFile() {
+		src_path = std::filesystem::temp_directory_path() / "aluar_bench_image.al";
+		img_path = image_path(src_path);
+		const std::string src = bench::arith_tree(18, nodes);
+		std::ofstream(src_path, std::ios::binary) << src;
+		source_stamp(src_path, stamp);
+		const Program prog = make_program(src, false, false, false);
+		save_image(img_path, prog.src, prog.forms, stamp, 0);
+	}
+
+	~ImagedFile() {
+		std::filesystem::remove(src_path);
+		std::filesystem::remove(img_path);
+	}
+};
+
+BENCH(startup_parse) {
+	ImagedFile f;
+	for (auto _ : st) {
+		const MappedFile file(f.src_path);
+		bench::keep(make_program(file.text(), false, false, false).forms.size());
+	}
+	st.set_items((double)f.nodes);
+}
+
+BENCH(startup_image) {
+	ImagedFile f;
+	for (auto _ : st) {
+		Image image(f.img_path);
+		bench::keep(image.load(f.stamp, 0));
+	}
+	st.set_items((double)f.nodes);
+}
@@ -0,0 +1,43 @@
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "eval.hpp"
+#include "io.hpp"
+#include "rope.hpp"
+#include "workload.hpp"
+
+static constexpr size_t total = 100 << 20;
+
+// a single 100 MiB string, written past the buffer in one call
+BENCH(print_100mb_flat) {
+	const std::string text(total, 'x');
+	const Value val = value_string(text);
+	bench::PipeOutput out;
+	for (auto _ : st) print_value(val);
+	st.set_bytes((double)total);
+}
+
+// the same amount as a rope of 1 MiB pieces
+BENCH(print_100mb_rope) {
+	const std::string piece(1 << 20, 'x');
+	std::vector<Rope> leaves;
+	leaves.reserve(total / piece.size());
+	for (size_t i = 0; i < total / piece.size(); i++) leaves.emplace_back(piece);
+	std::vector<Rope> links;
+	links.reserve(leaves.size());
+	const Rope *acc = &leaves[0];
+	for (size_t i = 1; i < leaves.size(); i++) acc = &links.emplace_back(acc, &leaves[i]);
+	bench::PipeOutput out;
+	for (auto _ : st) print_rope(*acc);
+	st.set_bytes((double)total);
+}
+
+// the same amount in short pieces, which the buffer gathers
+BENCH(print_100mb_pieces) {
+	const std::string piece(80, 'x');
+	bench::PipeOutput out;
+	for (auto _ : st)
+		for (size_t i = 0; i < total / piece.size(); i++) print_str(piece);
+	st.set_bytes((double)total);
+}
@@ -0,0 +1,48 @@
+#include <string>
+
+#include "bench.hpp"
+#include "lex.hpp"
+#include "scan.hpp"
+#include "workload.hpp"
+
+static const size_t input_size = 16 << 20;
+
+static void lex(bench::State &st, const std::string &src, ScanIsa isa) {
+	const ScanIsa old = scan_isa();
+	set_scan_isa(isa);
+	// pulled from a stream so that the token vector's page faults don't hide
+	// the cost of lexing
+	for (auto _ : st) {
+		TokenStream tks(src);
+		Token tk;
+		size_t n = 0;
+		while (tks.next(tk)) n++;
+		bench::keep(n);
+	}
+	set_scan_isa(old);
+	st.set_bytes((double)src.size());
+}
+
+#define LEX_BENCH(NAME, SRC)                         \
+	BENCH(lex_##NAME##_scalar) {                       \
+		lex(st, SRC, ScanIsa::Scalar);                   \
+	}                                                  \
+	BENCH(lex_##NAME##_sse2) { lex(st, SRC, ScanIsa::SSE2); } \
+	BENCH(lex_##NAME##_avx2) { lex(st, SRC, ScanIsa::AVX2); }
+
+static std::string arith() {
+	size_t nodes = 0;
+	return bench::arith_tree(20, nodes);
+}
+
+static const std::string arith_src = arith();
+static const std::string whitespace_src = bench::whitespace_heavy(input_size);
+static const std::string short_src = bench::long_literals(input_size, 4);
+static const std::string long_src = bench::long_literals(input_size, 200);
+
+LEX_BENCH(arith_tree, arith_src)
+LEX_BENCH(whitespace, whitespace_src)
+LEX_BENCH(short_literals, short_src)
+LEX_BENCH(long_literals, long_src)
+
+#undef LEX_BENCH
@@ -0,0 +1,188 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alloc.hpp"
+#include "bench.hpp"
+
+static std::atomic<uint64_t> alloc_count {0};
+
+static void count_alloc(size_t) {
+	alloc_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+// minimum measured time before a benchmark is reported
+const Clock::duration min_time = std::chrono::milliseconds(200);
+
+uint64_t allocations() {
+	return alloc_count.load(std::memory_order_relaxed);
+}
+
+static double scale_factor = 1.0;
+
+double scale() { return scale_factor; }
+
+State::Iterator State::begin() {
+	start_allocs = allocations();
+	start = Clock::now();
+	return Iterator {this, iterations};
+}
+
+State::Iterator State::end() { return Iterator {this, 0}; }
+
+void State::stop() {
+	elapsed = Clock::now() - start;
+	allocs = allocations() - start_allocs;
+}
+
+struct Entry {
+	const char *name;
+	Func *fn;
+};
+
+static std::vector<Entry> &registry() {
+	static std::vector<Entry> entries;
+	return entries;
+}
+
+Registrar::Registrar(const char *name, Func *fn) {
+	registry().push_back(Entry {name, fn});
+}
+
+// what a run measured, per iteration
+struct Result {
+	const char *name;
+	size_t iterations;
+	double ns;
+	double allocs;
+	double items_per_s; // 0 if not counted
+	double bytes_per_s;
+};
+
+static std::vector<Result> &results() {
+	static std::vector<Result> res;
+	return res;
+}
+
+void run(const char *name, Func *fn) {
+	State st {};
+	for (size_t n = 1;; n *= 4) {
+		st = State {};
+		st.iterations = n;
+		fn(st);
+		if (st.elapsed >= min_time || n >= (1ul << 30)) break;
+	}
+
+	const double ns =
+		(double)std::chrono::duration_cast<std::chrono::nanoseconds>(st.elapsed)
+			.count();
+	const double iters = (double)st.iterations;
+	printf(
+		"%-40s %12zu it %14.1f ns/it %10.2f allocs/it",
+		name,
+		st.iterations,
+		ns / iters,
+		(double)st.allocs / iters
+	);
+	if (st.items > 0)
+		printf(
+			" %10.4f allocs/item %10.2f Mitems/s",
+			(double)st.allocs / (iters * st.items),
+			st.items * iters * 1e3 / ns
+		);
+	if (st.bytes > 0) printf(" %10.2f MB/s", st.bytes * iters * 1e3 / ns);
+	printf("\n");
+	fflush(stdout);
+
+	results().push_back(Result {
+		name,
+		st.iterations,
+		ns / iters,
+		(double)st.allocs / iters,
+		st.items * iters * 1e9 / ns,
+		st.bytes * iters * 1e9 / ns,
+	});
+}
+
+// Writes the results as JSON, for bench/compare.py to compare runs
+static bool write_json(const char *path) {
+	std::ofstream out(path);
+	char buf[512];
+	snprintf(
+		buf,
+		sizeof(buf),
+		"{\"scale\": %g, \"threads\": %u, \"benchmarks\": [",
+		scale_factor,
+		std::thread::hardware_concurrency()
+	);
+	out << buf;
+	const auto &res = results();
+	for (size_t i = 0; i < res.size(); i++) {
+		const auto &r = res[i];
+		// names are identifiers, they need no escaping
+		snprintf(
+			buf,
+			sizeof(buf),
+			"%s\n{\"name\": \"%s\", \"iterations\": %zu, \"ns_per_it\": %.1f, "
+			"\"allocs_per_it\": %.2f, \"items_per_s\": %.1f, \"bytes_per_s\": %.1f}",
+			i == 0 ? "" : ",",
+			r.name,
+			r.iterations,
+			r.ns,
+			r.allocs,
+			r.items_per_s,
+			r.bytes_per_s
+		);
+		out << buf;
+	}
+	out << "]}\n";
+	return (bool)out;
+}
+
+} // namespace bench
+
+// Runs every benchmark whose name contains one of the filters, or all of
+// them if none is given.
+//   aluar_bench [--json FILE] [--scale FACTOR] [FILTER...]
+int main(int argc, char *argv[]) {
+	set_alloc_hook(count_alloc);
+	const char *json = nullptr;
+	std::vector<const char *> filters;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+			json = argv[++i];
+		else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+			bench::scale_factor = std::strtod(argv[++i], nullptr);
+		else
+			filters.push_back(argv[i]);
+	}
+	if (!(bench::scale_factor > 0)) {
+		fprintf(stderr, "--scale must be positive\n");
+		return 1;
+	}
+
+	// what the timings of pools can scale to
+	fprintf(stderr, "; %u hardware threads\n", std::thread::hardware_concurrency());
+	for (auto &e : bench::registry()) {
+		bool selected = filters.empty();
+		for (auto f : filters)
+			if (strstr(e.name, f) != nullptr) selected = true;
+		if (selected) bench::run(e.name, e.fn);
+	}
+	if (json != nullptr && !bench::write_json(json)) {
+		fprintf(stderr, "Could not write %s\n", json);
+		return 1;
+	}
+	return 0;
+}
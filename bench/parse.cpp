@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "lex.hpp"
+#include "parse.hpp"
+#include "workload.hpp"
+
+// parse and teardown of the whole tree
+BENCH(parse_arith_tree) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(16, nodes);
+	auto tks = tokenize(src);
+	for (auto _ : st) {
+		const auto tree = parse(tks, src);
+		bench::keep(tree.root);
+	}
+	st.set_items((double)nodes);
+}
+
+// many small top-level forms, pulled through a chunked stream
+BENCH(parse_stream_forms) {
+	const size_t forms = 10000;
+	size_t nodes = 0;
+	std::string src;
+	for (size_t i = 0; i < forms; i++) src += bench::arith_tree(3, nodes) + "\n";
+
+	for (auto _ : st) {
+		size_t off = 0;
+		TokenStream tks([&](char *buf, size_t cap) {
+			const size_t n = std::min(cap, src.size() - off);
+			src.copy(buf, n, off);
+			off += n;
+			return n;
+		}, 4096);
+		CST tree;
+		while (parse_form(tks, tree)) bench::keep(tree.root);
+	}
+	st.set_items((double)forms);
+	st.set_bytes((double)src.size());
+}
+
+// a million levels of nesting, which the parser handles without recursing
+BENCH(parse_deep_nesting) {
+	const size_t depth = 1000000;
+	std::string src;
+	for (size_t i = 0; i < depth; i++) src += "(not ";
+	src += "0";
+	src.append(depth, ')');
+	auto tks = tokenize(src);
+	for (auto _ : st) {
+		const auto tree = parse(tks, src);
+		bench::keep(tree.root);
+	}
+	st.set_items((double)depth);
+}
@@ -0,0 +1,41 @@
+#include <string>
+
+#include "bench.hpp"
+#include "eval.hpp"
+#include "lex.hpp"
+#include "parse.hpp"
+#include "profile.hpp"
+#include "vm.hpp"
+#include "workload.hpp"
+
+// What instrumentation costs: off, it should match the plain evaluators, and
+// on, every application of a builtin is timed.
+
+static void arith_eval(bench::State &st, bool on) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(16, nodes);
+	auto tks = tokenize(src);
+	const CST tree = parse(tks, src);
+	profile_on = on;
+	for (auto _ : st) bench::keep(eval(tree, src));
+	// place the spans recorded by address while the source is alive
+	profile_spans("", src);
+	profile_on = false;
+	st.set_items((double)nodes);
+}
+
+static void arith_vm(bench::State &st, bool on) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(16, nodes);
+	auto tks = tokenize(src);
+	const auto code = compile(parse(tks, src), src);
+	profile_on = on;
+	for (auto _ : st) bench::keep(run(code));
+	profile_on = false;
+	st.set_items((double)nodes);
+}
+
+BENCH(profile_off_eval) { arith_eval(st, false); }
+BENCH(profile_on_eval) { arith_eval(st, true); }
+BENCH(profile_off_vm) { arith_vm(st, false); }
+BENCH(profile_on_vm) { arith_vm(st, true); }
@@ -0,0 +1,50 @@
+#include <string>
+
+#include "bench.hpp"
+#include "eval.hpp"
+#include "io.hpp"
+#include "lex.hpp"
+#include "parse.hpp"
+#include "rope.hpp"
+#include "vm.hpp"
+#include "workload.hpp"
+
+// 64 levels over 256 KiB literals, for a 16 MiB result
+static constexpr size_t depth = 64;
+static constexpr size_t leaf_len = 256 << 10;
+
+BENCH(cat_deep_vm) {
+	const std::string src = bench::deep_cat(depth, leaf_len);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	const auto code = compile(tree, src);
+	for (auto _ : st) bench::keep(run(code).rope->size());
+	st.set_bytes((double)((depth + 1) * leaf_len));
+}
+
+BENCH(cat_deep_flatten) {
+	const std::string src = bench::deep_cat(depth, leaf_len);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	const auto code = compile(tree, src);
+	for (auto _ : st) bench::keep(run(code).rope->flat().size());
+	st.set_bytes((double)((depth + 1) * leaf_len));
+}
+
+// printing walks the pieces instead of flattening
+BENCH(cat_deep_print) {
+	const std::string src = bench::deep_cat(depth, leaf_len);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	const auto code = compile(tree, src);
+	const Value val = run(code);
+	std::string out;
+	out.reserve((depth + 1) * leaf_len);
+	std::string *prev = capture_output(&out);
+	for (auto _ : st) {
+		out.clear();
+		print_rope(*val.rope);
+	}
+	capture_output(prev);
+	st.set_bytes((double)((depth + 1) * leaf_len));
+}
@@ -0,0 +1,123 @@
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "eval.hpp"
+#include "gc.hpp"
+#include "io.hpp"
+#include "lex.hpp"
+#include "parse.hpp"
+#include "workload.hpp"
+
+// Generated workloads of a size set by --scale, each measured phase by phase.
+// A phase starts from what the ones before made, which is prepared once per
+// workload, so that tokenize, parse, eval and print are timed on their own.
+
+namespace {
+
+enum class Workload {
+	DeepArith,  // nested arithmetic, one application inside the next
+	WideCat,    // a single cat of many strings
+	Whitespace, // mostly runs of spaces and tabs
+	SmallScripts,
+};
+
+struct Prepared {
+	std::vector<std::string> sources;
+	std::vector<std::vector<Token>> tokens;
+	std::vector<CST> trees;
+	size_t bytes = 0;
+	size_t nodes = 0;
+};
+
+std::vector<std::string> generate(Workload w) {
+	size_t nodes = 0;
+	switch (w) {
+		case Workload::DeepArith: return {bench::deep_tree(bench::scaled(100000), nodes)};
+		case Workload::WideCat: return {bench::wide_cat(bench::scaled(100000), 8)};
+		case Workload::Whitespace: return {bench::whitespace_heavy(bench::scaled(16 << 20))};
+		case Workload::SmallScripts: return bench::small_scripts(bench::scaled(10000));
+	}
+	return {};
+}
+
+// built on first use, once the scale is known
+const Prepared &prepared(Workload w) {
+	static std::map<Workload, std::unique_ptr<Prepared>> cache;
+	auto &res = cache[w];
+	if (res) return *res;
+	res = std::make_unique<Prepared>();
+	res->sources = generate(w);
+	for (auto &src : res->sources) {
+		res->bytes += src.size();
+		res->tokens.push_back(tokenize(src));
+		res->trees.push_back(parse(res->tokens.back(), src));
+		res->nodes += res->trees.back().nodes.size();
+	}
+	return *res;
+}
+
+void tokenize_phase(bench::State &st, Workload w) {
+	const auto &p = prepared(w);
+	for (auto _ : st)
+		for (auto &src : p.sources) bench::keep(tokenize(src).size());
+	st.set_bytes((double)p.bytes);
+}
+
+void parse_phase(bench::State &st, Workload w) {
+	const auto &p = prepared(w);
+	// parse takes the tokens by mutable reference, without changing them
+	auto tokens = p.tokens;
+	for (auto _ : st)
+		for (size_t i = 0; i < p.sources.size(); i++)
+			bench::keep(parse(tokens[i], p.sources[i]).root);
+	st.set_items((double)p.nodes);
+	st.set_bytes((double)p.bytes);
+}
+
+void eval_phase(bench::State &st, Workload w) {
+	const auto &p = prepared(w);
+	Heap heap;
+	Heap *prev = set_value_heap(&heap);
+	for (auto _ : st)
+		for (size_t i = 0; i < p.sources.size(); i++)
+			bench::keep(eval(p.trees[i], p.sources[i]));
+	set_value_heap(prev);
+	st.set_items((double)p.nodes);
+}
+
+void print_phase(bench::State &st, Workload w) {
+	const auto &p = prepared(w);
+	Heap heap;
+	Heap *prev = set_value_heap(&heap);
+	std::vector<Value> vals;
+	for (size_t i = 0; i < p.sources.size(); i++) {
+		vals.push_back(eval(p.trees[i], p.sources[i]));
+		// or the next evaluation may collect it
+		heap.pin(vals.back());
+	}
+	{
+		bench::PipeOutput out;
+		for (auto _ : st)
+			for (auto &val : vals) print_value(val);
+	}
+	set_value_heap(prev);
+	st.set_items((double)vals.size());
+}
+
+} // namespace
+
+#define SUITE(NAME, WORKLOAD)                                                      \
+	BENCH(suite_##NAME##_tokenize) { tokenize_phase(st, Workload::WORKLOAD); } \
+	BENCH(suite_##NAME##_parse) { parse_phase(st, Workload::WORKLOAD); }       \
+	BENCH(suite_##NAME##_eval) { eval_phase(st, Workload::WORKLOAD); }         \
+	BENCH(suite_##NAME##_print) { print_phase(st, Workload::WORKLOAD); }
+
+SUITE(deep_arith, DeepArith)
+SUITE(wide_cat, WideCat)
+SUITE(whitespace, Whitespace)
+SUITE(small_scripts, SmallScripts)
+
+#undef SUITE
@@ -0,0 +1,45 @@
+#include <cstdio>
+#include <string>
+
+#include "bench.hpp"
+#include "lex.hpp"
+#include "parse.hpp"
+#include "symbol.hpp"
+#include "workload.hpp"
+
+// Interning a large generated script, with a report of what its symbols cost
+// in the table against a string per reference
+static void words(bench::State &st, const char *name, size_t vocab, size_t len) {
+	const std::string src = bench::many_words(16 << 20, vocab, len);
+	const SymbolStats before = symbol_stats();
+	size_t nodes = 0;
+	for (auto _ : st) {
+		auto tks = tokenize(src);
+		const CST tree = parse(tks, src);
+		nodes = tree.nodes.size();
+		bench::keep(nodes);
+	}
+	const SymbolStats after = symbol_stats();
+
+	const size_t refs = after.references - before.references;
+	const size_t strings = after.string_bytes - before.string_bytes;
+	const size_t table = after.table_bytes - before.table_bytes;
+	const size_t used = table + refs * sizeof(SymbolId);
+	fprintf(
+		stderr,
+		"; %s: %zu unique symbols, %zu references, %zu bytes in the table, "
+		"%zu bytes as strings, %zu bytes saved\n",
+		name,
+		after.unique - before.unique,
+		refs,
+		table,
+		strings,
+		strings > used ? strings - used : 0
+	);
+	st.set_items((double)nodes);
+	st.set_bytes((double)src.size());
+}
+
+// names that fit inside a std::string, and names that don't
+BENCH(symbols_short_names) { words(st, "symbols_short_names", 1 << 12, 8); }
+BENCH(symbols_long_names) { words(st, "symbols_long_names", 1 << 16, 24); }
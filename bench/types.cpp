@@ -0,0 +1,64 @@
+#include <string>
+
+#include "bench.hpp"
+#include "eval.hpp"
+#include "gc.hpp"
+#include "lex.hpp"
+#include "parse.hpp"
+#include "types.hpp"
+#include "vm.hpp"
+#include "workload.hpp"
+
+// Each workload runs as parsed, with every application checking its
+// arguments, and after check_types, with the typed builtins and VM ops.
+
+static CST parsed(const std::string &src, bool typed) {
+	auto tks = tokenize(src);
+	CST tree = parse(tks, src);
+	if (typed) check_types(tree, src);
+	return tree;
+}
+
+static void arith_eval(bench::State &st, bool typed) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(16, nodes);
+	const CST tree = parsed(src, typed);
+	for (auto _ : st) bench::keep(eval(tree, src));
+	st.set_items((double)nodes);
+}
+
+static void arith_vm(bench::State &st, bool typed) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(16, nodes);
+	const auto code = compile(parsed(src, typed), src);
+	for (auto _ : st) bench::keep(run(code));
+	st.set_items((double)nodes);
+}
+
+// short strings, so that the cost is in applying cat rather than copying
+static void cat_vm(bench::State &st, bool typed) {
+	static constexpr size_t depth = 4096;
+	const std::string src = bench::deep_cat(depth, 8);
+	const auto code = compile(parsed(src, typed), src);
+	Heap heap;
+	Heap *prev = set_value_heap(&heap);
+	for (auto _ : st) bench::keep(run(code));
+	set_value_heap(prev);
+	st.set_items((double)depth);
+}
+
+BENCH(arith_tree_eval_checked) { arith_eval(st, false); }
+BENCH(arith_tree_eval_typed) { arith_eval(st, true); }
+BENCH(arith_tree_vm_checked) { arith_vm(st, false); }
+BENCH(arith_tree_vm_typed) { arith_vm(st, true); }
+BENCH(cat_vm_checked) { cat_vm(st, false); }
+BENCH(cat_vm_typed) { cat_vm(st, true); }
+
+// the cost of the pass itself
+BENCH(arith_tree_check_types) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(16, nodes);
+	CST tree = parsed(src, false);
+	for (auto _ : st) bench::keep(check_types(tree, src));
+	st.set_items((double)nodes);
+}
@@ -0,0 +1,121 @@
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "eval.hpp"
+#include "lex.hpp"
+#include "opt.hpp"
+#include "parse.hpp"
+#include "vm.hpp"
+#include "workload.hpp"
+
+struct Compiled {
+	std::string src;
+	std::vector<Token> tks;
+	CST tree;
+	Bytecode code;
+
+	Compiled(const std::string &source)
+	: src {source}, tks {tokenize(src)}, tree {parse(tks, src)} {
+		if (tree.success()) code = compile(tree, src);
+	}
+};
+
+// examples/ programs that parse, compiled for both backends
+static std::vector<Compiled *> example_programs() {
+	std::vector<Compiled *> res;
+	for (auto &src : bench::examples()) {
+		auto prog = new Compiled(src);
+		if (prog->tree.success())
+			res.push_back(prog);
+		else
+			delete prog;
+	}
+	return res;
+}
+
+BENCH(examples_eval) {
+	auto progs = example_programs();
+	for (auto _ : st)
+		for (auto p : progs) bench::keep(eval(p->tree, p->src));
+	st.set_items((double)progs.size());
+	for (auto p : progs) delete p;
+}
+
+BENCH(examples_vm) {
+	auto progs = example_programs();
+	for (auto _ : st)
+		for (auto p : progs) bench::keep(run(p->code));
+	st.set_items((double)progs.size());
+	for (auto p : progs) delete p;
+}
+
+BENCH(arith_tree_eval) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(16, nodes);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	for (auto _ : st) bench::keep(eval(tree, src));
+	st.set_items((double)nodes);
+}
+
+BENCH(arith_tree_vm) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(16, nodes);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	const auto code = compile(tree, src);
+	for (auto _ : st) bench::keep(run(code));
+	st.set_items((double)nodes);
+}
+
+BENCH(arith_tree_compile) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(16, nodes);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	for (auto _ : st) bench::keep(compile(tree, src).code.size());
+	st.set_items((double)nodes);
+}
+
+// folds the whole tree down to a single literal
+BENCH(arith_tree_fold) {
+	size_t nodes = 0;
+	const std::string src = bench::arith_tree(16, nodes);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	for (auto _ : st) {
+		CST copy = tree;
+		bench::keep(fold_constants(copy, src).folded);
+	}
+	st.set_items((double)nodes);
+}
+
+// a million nested applications, evaluated without recursing
+BENCH(deep_tree_eval) {
+	size_t nodes = 0;
+	const std::string src = bench::deep_tree(1000000, nodes);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	for (auto _ : st) bench::keep(eval(tree, src));
+	st.set_items((double)nodes);
+}
+
+BENCH(deep_tree_vm) {
+	size_t nodes = 0;
+	const std::string src = bench::deep_tree(1000000, nodes);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	const auto code = compile(tree, src);
+	for (auto _ : st) bench::keep(run(code));
+	st.set_items((double)nodes);
+}
+
+BENCH(deep_tree_compile) {
+	size_t nodes = 0;
+	const std::string src = bench::deep_tree(1000000, nodes);
+	auto tks = tokenize(src);
+	const auto tree = parse(tks, src);
+	for (auto _ : st) bench::keep(compile(tree, src).code.size());
+	st.set_items((double)nodes);
+}
@@ -0,0 +1,163 @@
+#include "workload.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "io.hpp"
+
+namespace bench {
+
+std::string arith_tree(size_t depth, size_t &nodes) {
+	static const char *ops[] = {"add", "sub", "mul", "and", "xor"};
+	nodes++;
+	if (depth == 0) return std::to_string(nodes % 100);
+	nodes++; // function symbol
+	std::string res = "(";
+	res += ops[depth % 5];
+	res += ' ';
+	res += arith_tree(depth - 1, nodes);
+	res += ' ';
+	res += arith_tree(depth - 1, nodes);
+	res += ')';
+	return res;
+}
+
+std::string wide_tree(size_t width, size_t depth, size_t &nodes) {
+	nodes += 2;
+	std::string res = "(add";
+	for (size_t i = 0; i < width; i++) {
+		res += ' ';
+		res += arith_tree(depth, nodes);
+	}
+	res += ')';
+	return res;
+}
+
+std::string deep_tree(size_t depth, size_t &nodes) {
+	static const char *ops[] = {"add", "sub"};
+	std::string res;
+	res.reserve(depth * 8);
+	for (size_t i = 0; i < depth; i++) {
+		res += '(';
+		res += ops[i % 2];
+		res += ' ';
+		res += (char)('1' + i % 9);
+		res += ' ';
+	}
+	res += '0';
+	res.append(depth, ')');
+	nodes += 3 * depth + 1;
+	return res;
+}
+
+std::string deep_cat(size_t depth, size_t len) {
+	const std::string leaf = '"' + std::string(len, 'x') + '"';
+	// every opening paren comes first, so the source is built by appending
+	std::string res;
+	res.reserve(depth * (leaf.size() + 7) + leaf.size());
+	for (size_t i = 0; i < depth; i++) res += "(cat ";
+	res += leaf;
+	for (size_t i = 0; i < depth; i++) {
+		res += ' ';
+		res += leaf;
+		res += ')';
+	}
+	return res;
+}
+
+std::string whitespace_heavy(size_t size) {
+	std::string res = "(add";
+	for (size_t i = 0; res.size() < size; i++) {
+		res.append(40 + i % 25, ' ');
+		res.append(i % 7, '\t');
+		res += std::to_string(i % 10);
+	}
+	return res + ")";
+}
+
+std::string long_literals(size_t size, size_t len) {
+	std::string res = "(cat";
+	for (size_t i = 0; res.size() < size; i++) {
+		res += ' ';
+		switch (i % 3) {
+			case 0: res.append(len, (char)('a' + i % 26)); break;
+			case 1: res.append(len, (char)('0' + i % 10)); break;
+			case 2:
+				res += '"';
+				res.append(len, (char)('A' + i % 26));
+				res += '"';
+				break;
+		}
+	}
+	return res + ")";
+}
+
+std::string wide_cat(size_t width, size_t len) {
+	std::string res = "(cat";
+	for (size_t i = 0; i < width; i++) {
+		res += " \"";
+		res.append(len, (char)('a' + i % 26));
+		res += '"';
+	}
+	return res + ")";
+}
+
+std::vector<std::string> small_scripts(size_t count) {
+	std::vector<std::string> res;
+	res.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		const std::string n = std::to_string(i);
+		res.push_back("(add " + n + " (mul 2 3)\n  (shl (xor " + n + " 255) 3))\n");
+	}
+	return res;
+}
+
+std::string many_words(size_t size, size_t vocab, size_t len) {
+	std::string res = "(cat";
+	for (size_t i = 0; res.size() < size; i++) {
+		res += ' ';
+		// the index in the vocabulary in base 26, padded with a
+		size_t n = i % vocab;
+		for (size_t k = 0; k < len; k++, n /= 26) res += (char)('a' + n % 26);
+	}
+	return res + ")";
+}
+
+std::vector<std::string> examples() {
+	std::vector<std::string> res;
+	for (auto &entry : std::filesystem::directory_iterator(ALUAR_EXAMPLES_DIR))
+		if (entry.path().extension() == ".al")
+			res.emplace_back(MappedFile(entry.path()).text());
+	return res;
+}
+
+PipeOutput::PipeOutput() {
+	if (pipe(fds) != 0) abort();
+	// fewer wakeups of the reader
+	fcntl(fds[1], F_SETPIPE_SZ, 1 << 20);
+	drain = std::thread([fd = fds[0]] {
+		std::vector<char> buf(1 << 20);
+		while (true) {
+			const ssize_t n = read(fd, buf.data(), buf.size());
+			if (n == 0 || (n < 0 && errno != EINTR)) break;
+		}
+	});
+	stdout_sink().redirect(fds[1]);
+}
+
+PipeOutput::~PipeOutput() {
+	// flushes what is left into the pipe, then ends it for the reader
+	stdout_sink().redirect(STDOUT_FILENO);
+	close(fds[1]);
+	drain.join();
+	close(fds[0]);
+}
+
+} // namespace bench
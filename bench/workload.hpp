@@ -0,0 +1,60 @@
+#ifndef ALUAR_BENCH_WORKLOAD_HPP
+#define ALUAR_BENCH_WORKLOAD_HPP
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+// Balanced tree of arithmetic applications with two operands per level.
+// nodes is incremented by the number of CST nodes generated.
+std::string arith_tree(size_t depth, size_t &nodes);
+
+// Application of add over width arithmetic trees of the given depth.
+std::string wide_tree(size_t width, size_t depth, size_t &nodes);
+
+// Right-leaning chain of depth arithmetic applications, each taking a number
+// and the next one. nodes is incremented by the number of CST nodes generated.
+std::string deep_tree(size_t depth, size_t &nodes);
+
+// Left-leaning chain of depth applications of cat, each adding a string
+// literal of len bytes.
+std::string deep_cat(size_t depth, size_t len);
+
+// Flat application of about size bytes, whose operands are separated by long
+// runs of spaces and tabs.
+std::string whitespace_heavy(size_t size);
+
+// Flat application of cat over width string literals of len bytes.
+std::string wide_cat(size_t width, size_t len);
+
+// count short programs, each a single form of a few applications
+std::vector<std::string> small_scripts(size_t count);
+
+// Flat application of about size bytes over words, numbers and string
+// literals of the given length.
+std::string long_literals(size_t size, size_t len);
+
+// Flat application of about size bytes over words of len letters, drawn in
+// turn from a vocabulary of vocab distinct names.
+std::string many_words(size_t size, size_t vocab, size_t len);
+
+// sources of the programs in examples/
+std::vector<std::string> examples();
+
+// Prints into a pipe through the stdout sink for the duration of the bench,
+// read and dropped by a thread like a consumer downstream would. Unlike with
+// /dev/null, every byte is copied through the kernel.
+struct PipeOutput {
+	int fds[2];
+	std::thread drain;
+
+	PipeOutput();
+	~PipeOutput();
+};
+
+} // namespace bench
+
+#endif
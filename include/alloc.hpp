@@ -0,0 +1,15 @@
+#ifndef ALUAR_ALLOC_HPP
+#define ALUAR_ALLOC_HPP
+
+#include <cstdlib>
+
+// alloc.cpp replaces every form of the global operator new and delete that
+// the aligned ones don't cover, so that none is left to a sanitizer's
+// allocator and then freed by ours. It's linked into the executables, not the
+// library, which leaves embedders their own.
+
+// Called with the size of each allocation, if set. Set before any thread runs.
+using AllocHook = void (*)(size_t bytes);
+void set_alloc_hook(AllocHook hook);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef ALUAR_ARENA_HPP
+#define ALUAR_ARENA_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+// Bump allocator. Objects allocated from it are never freed one by one, the
+// whole arena is released at once on reset or destruction.
+struct Arena {
+	Arena(size_t chunk_size = 64 * 1024);
+	~Arena();
+
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	void *alloc(size_t size, size_t align);
+
+	// Objects with non-trivial destructors get them called on release.
+	template<typename T, typename... Args>
+	T *make(Args &&...args) {
+		T *obj = new (alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		if constexpr (!std::is_trivially_destructible_v<T>)
+			on_release([](void *p) { ((T *)p)->~T(); }, obj);
+		return obj;
+	}
+
+	// uninitialized array of trivial values
+	template<typename T>
+	std::span<T> array(size_t n) {
+		static_assert(std::is_trivially_destructible_v<T>);
+		return {(T *)alloc(n * sizeof(T), alignof(T)), n};
+	}
+
+	// Releases everything but the first chunk, which is kept for reuse.
+	void reset();
+
+	// bytes handed out since the last reset
+	size_t used() const { return used_bytes; }
+
+ private:
+	struct Chunk {
+		Chunk *prev;
+		size_t size;
+	};
+
+	struct Finalizer {
+		void (*fn)(void *);
+		void *obj;
+		Finalizer *prev;
+	};
+
+	size_t chunk_size;
+	Chunk *chunk = nullptr;
+	char *cur = nullptr;
+	char *end = nullptr;
+	Finalizer *finalizers = nullptr;
+	size_t used_bytes = 0;
+
+	void on_release(void (*fn)(void *), void *obj);
+	void finalize();
+};
+
+#endif
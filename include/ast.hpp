@@ -3,9 +3,17 @@
 
 #include <cstdint>
 #include <map>
+#include <span>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "arena.hpp"
+#include "bigint.hpp"
+#include "gc.hpp"
+#include "symbol.hpp"
+
 using std::map;
 using std::string;
 using std::vector;
@@ -15,6 +23,7 @@ namespace AST {
 enum class Type {
 	App,
 	Arrow,
+	BigNumber,
 	Error,
 	List,
 	Nil,
@@ -25,142 +34,149 @@ enum class Type {
 };
 
 struct Node;
-struct Symbol;
+struct App;
+struct Builtin;
+
+// An application whose arguments are being reduced
+struct Call {
+	const App* app;
+	const Builtin* arrow;
+	size_t base; // where its arguments start on the stack
+	size_t next; // child being reduced
+};
+
+// Environment of a reduction. Globals are indexed by interned symbol. The
+// arguments of the calls in progress live on a stack, and a callee only sees
+// its own frame of it, where parameters are addressed by slot. Pushing and
+// popping a frame copies nothing, and nested calls never clobber each other.
+struct Env {
+	vector<const Node*> globals;
+	vector<const Node*> stack;
+	size_t frame = 0; // base of the innermost frame
+	vector<Call> calls; // applications in progress
+	Heap* heap = nullptr; // where reductions make their values, if not leaked
+
+	const Node* lookup(SymbolId sym) const {
+		return sym < globals.size() ? globals[sym] : nullptr;
+	}
+
+	void define(SymbolId sym, const Node* val) {
+		if (sym >= globals.size()) globals.resize(sym + 1, nullptr);
+		globals[sym] = val;
+	}
 
-using Env = map<Symbol, const Node*>;
+	// value of the parameter in the given slot of the current call
+	const Node* arg(size_t slot) const { return stack[frame + slot]; }
 
+	template<typename T, typename... Args>
+	const Node* make(Args&&... args) {
+		if (heap != nullptr) return heap->make<T>(std::forward<Args>(args)...);
+		return new T(std::forward<Args>(args)...);
+	}
+};
+
+// The kinds of nodes are closed: each one is a single struct, named by the tag
+// of the node, so dispatching on them is a switch rather than a virtual call
+// or a dynamic_cast. See visit.
 struct Node {
-	virtual Type type() const = 0;
-	virtual bool is_leaf() const = 0;
-	virtual const Node* reduce(Env& env) const = 0;
+	Type tag;
+
+	Type type() const { return tag; }
+	bool is_leaf() const;
+	// reduces applications and programs, everything else is its own value
+	const Node* reduce(Env& env) const;
+
+ protected:
+	Node(Type tag) : tag {tag} {}
 };
 
 struct Branch : Node {
-	vector<Node*> children;
+	std::span<Node*> children; // allocated in the arena of the tree
 
-	bool is_leaf() const override { return false; }
+	Branch(Type tag, std::span<Node*> children = {})
+		: Node(tag), children {children} {}
 };
 
 struct Leaf : Node {
-	bool is_leaf() const override { return true; }
-	const Node* reduce([[maybe_unused]] Env& env) const override { return this; }
-};
-
-struct Arrow : Branch {
-	Type type() const override { return Type::Arrow; }
-	virtual const vector<Node*>& arg_list() const = 0;
+	Leaf(Type tag) : Node(tag) {}
 };
 
-struct Builtin : Arrow {
+// The only kind of arrow. Parameters are the children, as symbols.
+struct Builtin : Branch {
 	using Func = const Node* (*)(Env& env);
 
 	Func impl;
 
-	Builtin(Func impl) : Arrow(), impl {impl} {}
-	const Node* reduce([[maybe_unused]] Env& env) const override {
-		return impl(env);
-	}
-	const vector<Node*>& arg_list() const override { return children; }
+	Builtin(Func impl, std::span<Node*> params)
+		: Branch(Type::Arrow, params), impl {impl} {}
+
+	const Node* reduce(Env& env) const { return impl(env); }
+	std::span<Node* const> arg_list() const { return children; }
 };
 
 struct Number : Leaf {
 	int64_t val;
 
-	Number(int64_t num) : Leaf(), val {num} {}
+	Number(int64_t num) : Leaf(Type::Number), val {num} {}
+};
+
+// Never fits an int64_t, smaller results are Numbers
+struct BigNumber : Leaf {
+	BigInt val;
 
-	Type type() const override { return Type::Number; }
+	BigNumber(BigInt val) : Leaf(Type::BigNumber), val {std::move(val)} {}
 };
 
+inline size_t gc_extra(const BigNumber& num) { return ::gc_extra(num.val); }
+
 struct String : Leaf {
 	std::string val;
 
-	Type type() const override { return Type::String; }
+	String(std::string val = {}) : Leaf(Type::String), val {std::move(val)} {}
 };
 
 struct Symbol : Leaf {
-	std::string val;
-
-	Symbol(const char* val) : Leaf(), val {val} {}
+	SymbolId id;
 
-	Type type() const override { return Type::Symbol; }
+	Symbol(const char* val) : Leaf(Type::Symbol), id {intern(val)} {}
+	Symbol(SymbolId id) : Leaf(Type::Symbol), id {id} {}
 
 	friend bool operator<(const Symbol& l, const Symbol& r) {
-		return l.val < r.val;
+		return l.id < r.id;
 	}
 };
 
 struct Nil : Leaf {
-	Type type() const override { return Type::Nil; }
+	Nil() : Leaf(Type::Nil) {}
 };
 
 struct Error : Leaf {
 	string msg;
 
-	Error(const char* msg) : Leaf(), msg {msg} {}
-
-	Type type() const override { return Type::Nil; }
+	Error(const char* msg) : Leaf(Type::Error), msg {msg} {}
 };
 
 struct List : Branch {
-	Type type() const override { return Type::List; }
+	List(std::span<Node*> children = {}) : Branch(Type::List, children) {}
 };
 
 struct App : Branch {
-	Type type() const override { return Type::App; }
-
-	const Node* reduce(Env& env) const override {
-		if (children.size() < 1) return new Error("Empty application");
-
-		const Node* fst = children[0];
-		if (fst->type() != Type::Symbol)
-			return new Error("Application first value must be a symbol");
-
-		const Symbol* func_ident = dynamic_cast<const Symbol*>(fst);
-
-		// func not in env
-		if (env.find(*func_ident) == env.end())
-			return new Error("Symbol doesn't refer to any value");
-
-		const Node* sym_val = env[*func_ident];
-
-		if (sym_val->type() != Type::Arrow)
-			return new Error("Symbol does not refer to an arrow");
-
-		const Arrow* arrow = dynamic_cast<const Arrow*>(sym_val);
-
-		const vector<Node*>& arg_list = arrow->arg_list();
-
-		if ((children.size() - 1) != arg_list.size())
-			return new Error("Wrong number of arguments");
+	App(std::span<Node*> children = {}) : Branch(Type::App, children) {}
 
-		// assign arguments to parameter symbols on environment
-		for (size_t i = 0; i < arg_list.size(); i++) {
-			const Node* arg = arg_list[i];
-			if (arg->type() != Type::Symbol)
-				return new Error("Parameter must be a symbol");
+	// Reduces nested applications with an explicit stack of calls in the
+	// environment, so deep trees do not recurse on the native stack
+	const Node* reduce(Env& env) const;
 
-			const Symbol* param_sym = dynamic_cast<const Symbol*>(arg);
-
-			env[*param_sym] = children[i + 1]->reduce(env);
-		}
-
-		const Node* ret = arrow->reduce(env);
-
-		// remove parameters from environment
-		for (size_t i = 0; i < arg_list.size(); i++) {
-			const Symbol* param_sym = dynamic_cast<const Symbol*>(arg_list[i]);
-			env.erase(env.find(*param_sym));
-		}
-
-		return ret;
-	}
+	// Checks the head of the application and starts a call of it. Returns the
+	// first argument to reduce, or nullptr when the result is already in res.
+	const Node* enter(Env& env, const Node*& res) const;
 };
 
 struct Program : Branch {
-	Type type() const override { return Type::Program; }
+	Program(std::span<Node*> children = {}) : Branch(Type::Program, children) {}
 
-	const Node* reduce(Env& env) const override {
-		if (children.size() == 0) return new Nil;
+	const Node* reduce(Env& env) const {
+		if (children.size() == 0) return env.make<Nil>();
 
 		const Node* res = nullptr;
 		for (auto& c : children) {
@@ -170,7 +186,44 @@ struct Program : Branch {
 	};
 };
 
+// Calls f with the node cast to its own struct, picked by a switch on the tag.
+// Every call of f must return the same type.
+template<typename F>
+decltype(auto) visit(const Node* node, F&& f) {
+	switch (node->tag) {
+		case Type::App: return f(static_cast<const App*>(node));
+		case Type::Arrow: return f(static_cast<const Builtin*>(node));
+		case Type::BigNumber: return f(static_cast<const BigNumber*>(node));
+		case Type::Error: return f(static_cast<const Error*>(node));
+		case Type::List: return f(static_cast<const List*>(node));
+		case Type::Nil: return f(static_cast<const Nil*>(node));
+		case Type::Number: return f(static_cast<const Number*>(node));
+		case Type::Program: return f(static_cast<const Program*>(node));
+		case Type::String: return f(static_cast<const String*>(node));
+		case Type::Symbol: return f(static_cast<const Symbol*>(node));
+	}
+	__builtin_unreachable();
+}
+
+inline bool Node::is_leaf() const {
+	return visit(this, [](auto node) {
+		return std::is_base_of_v<Leaf, std::remove_cvref_t<decltype(*node)>>;
+	});
+}
+
+inline const Node* Node::reduce(Env& env) const {
+	return visit(this, [&env](auto node) -> const Node* {
+		using T = std::remove_cvref_t<decltype(*node)>;
+		if constexpr (std::is_same_v<T, App> || std::is_same_v<T, Program>)
+			return node->reduce(env);
+		else
+			return node;
+	});
+}
+
 struct AST {
+	Arena arena; // owns every node of the tree and the builtins
+	Heap heap;   // owns the values made by reducing it
 	const Node* root;
 	Env env;
 
@@ -0,0 +1,43 @@
+#ifndef ALUAR_BIGINT_HPP
+#define ALUAR_BIGINT_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Arbitrary precision integer in sign and magnitude. The magnitude is in
+// 64-bit limbs, least significant first, without leading zero limbs, so zero
+// has none.
+struct BigInt {
+	bool neg = false;
+	std::vector<uint64_t> mag;
+
+	BigInt() = default;
+	explicit BigInt(int64_t n);
+
+	// Parses an optionally negative decimal. Returns false if it's not one.
+	static bool parse(std::string_view src, BigInt &out);
+
+	bool is_zero() const { return mag.empty(); }
+	// whether it fits an int64_t, which is then stored in out
+	bool to_int(int64_t &out) const;
+	std::string to_string() const;
+};
+
+BigInt operator-(const BigInt &a);
+BigInt operator+(const BigInt &a, const BigInt &b);
+BigInt operator-(const BigInt &a, const BigInt &b);
+BigInt operator*(const BigInt &a, const BigInt &b);
+// truncates towards zero like integer division, b must not be zero
+BigInt operator/(const BigInt &a, const BigInt &b);
+BigInt operator<<(const BigInt &a, size_t bits);
+// rounds towards negative infinity like an arithmetic shift
+BigInt operator>>(const BigInt &a, size_t bits);
+
+// Operands of at least this many limbs are multiplied by Karatsuba instead of
+// the schoolbook method.
+constexpr size_t karatsuba_threshold = 32;
+
+#endif
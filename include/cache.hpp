@@ -0,0 +1,95 @@
+#ifndef ALUAR_CACHE_HPP
+#define ALUAR_CACHE_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "eval.hpp"
+#include "parse.hpp"
+#include "vm.hpp"
+
+// Source parsed into its top-level forms, ready to run again and again
+struct Program {
+	struct Form {
+		CST tree;
+		size_t offset; // in src of the text the tree is relative to
+		size_t line;   // the text starts in
+		size_t column; // of that line the text starts at
+		Bytecode code; // if compiled
+		bool ill_typed; // parsed, but rejected by check_types
+	};
+
+	std::string src;
+	// up to and including the first one with syntax or type errors
+	std::vector<Form> forms;
+	bool compiled;
+
+	bool success() const { return forms.empty() || forms.back().tree.success(); }
+	std::string_view text(const Form &form) const {
+		return std::string_view(src).substr(form.offset);
+	}
+
+	// Runs the forms in order, stopping at the first error, and returns the
+	// value of the last one. Boxed values may point into the program. The
+	// tree is walked unless asked for the VM and the program was compiled.
+	Value run(bool vm) const;
+	// approximate memory held
+	size_t bytes() const;
+};
+
+// Parses, and optionally type checks, folds and compiles, every form of src
+Program make_program(std::string_view src, bool check, bool fold, bool compile);
+
+uint64_t hash_source(std::string_view src);
+
+// Programs by the hash of their source, evicting the least recently used ones
+// past a memory bound. Safe to share between threads; programs handed out
+// stay alive while in use, even if evicted meanwhile.
+struct ProgramCache {
+	struct Options {
+		size_t max_bytes = 64 << 20;
+		bool check = true;
+		bool fold = false;
+		bool compile = false;
+	};
+
+	struct Stats {
+		size_t hits;
+		size_t misses;
+		size_t evictions;
+		size_t entries;
+		size_t bytes;
+	};
+
+	explicit ProgramCache(Options opts);
+	ProgramCache() : ProgramCache(Options {}) {}
+
+	std::shared_ptr<const Program> get(std::string_view src);
+	Stats stats() const;
+	void clear();
+
+ private:
+	struct Entry {
+		uint64_t hash;
+		std::shared_ptr<const Program> prog;
+		size_t bytes;
+	};
+	using Lru = std::list<Entry>; // most recently used first
+
+	Options opts;
+	mutable std::mutex mutex;
+	Lru lru;
+	std::unordered_multimap<uint64_t, Lru::iterator> index;
+	Stats counts {};
+
+	void evict();
+};
+
+#endif
@@ -3,13 +3,22 @@
 
 #include <cstdint>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 
 #include "parse.hpp"
+#include "symbol.hpp"
 
+struct BigInt;
+struct Rope;
+
+// Tagged value. Numbers, symbols and nil live inline, only strings, error
+// messages and numbers too large for 64 bits are boxed on the heap.
 struct Value {
 	enum class Type {
 		Number,
+		BigNumber, // never fits an int64_t
 		Symbol,
 		String,
 		Error,
@@ -17,9 +26,58 @@ struct Value {
 	};
 
 	Type type;
-	void *box; // type-erased value
+	union {
+		int64_t num;
+		SymbolId sym;
+		const Rope *rope;       // String payload
+		const std::string *str; // Error payload
+		const BigInt *big;
+	};
 };
 
-Value eval(const CST &tree, const std::string &src);
+struct Arena;
+struct Heap;
+
+// Strings and errors made by the calling thread are boxed in the arena from
+// now on, or on the heap if null. Returns the previous one.
+Arena *set_value_arena(Arena *arena);
+
+// Without an arena, they are boxed in the garbage collected heap from now on,
+// or leaked if null. Returns the previous one.
+Heap *set_value_heap(Heap *heap);
+
+// Safe point of the evaluators. Collects the heap of the calling thread if
+// it's due, with the values in live as the only roots besides pinned ones.
+void collect_values(std::span<const Value> live);
+
+// Text of a string value. Flattening it counts towards the heap of the
+// calling thread, if the rope is one of its objects.
+std::string_view value_text(const Value &str);
+
+Value value_string(std::string_view str);
+Value value_rope(const Rope *rope);
+Value value_error(std::string_view error_msg);
+Value value_sym(SymbolId sym);
+Value value_num(int64_t num);
+// boxed only if it does not fit an int64_t
+Value value_big(BigInt &&num);
+// number from its decimal representation, of any size
+Value value_number(std::string_view digits);
+Value value_nil();
+
+using Evaluator = Value(std::span<Value>);
+
+// indexed by builtin slot, see the Builtin enum
+extern Evaluator *const builtins[builtin_count];
+// The same, without the checks that check_types makes for typed applications.
+// Only to be applied to arguments of the types the builtin takes.
+extern Evaluator *const typed_builtins[builtin_count];
+
+struct Pool;
+
+Value eval(const CST &tree, std::string_view src);
+// Evaluates the arguments of pure applications on the threads of the pool.
+// The result is the same as evaluating sequentially.
+Value eval(const CST &tree, std::string_view src, Pool &pool);
 
 #endif
@@ -0,0 +1,210 @@
+#ifndef ALUAR_GC_HPP
+#define ALUAR_GC_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "eval.hpp"
+
+struct BigInt;
+struct Rope;
+
+// bytes an object owns besides itself
+size_t gc_extra(const Rope &rope);
+size_t gc_extra(const std::string &str);
+size_t gc_extra(const BigInt &big);
+template<typename T>
+size_t gc_extra(const T &) {
+	return 0;
+}
+
+// Heap of runtime values, reclaimed by mark and sweep. Collections only
+// happen at safe points, where whoever asks for one marks every object it
+// still uses as a root. The evaluators do so between applications, with
+// their stacks. Pointers to objects of other heaps or of no heap may be
+// marked too and are ignored, so those must never point back into this one.
+// A heap must only be used by one thread at a time.
+//
+// Collections are generational. Values never change once made, so an object
+// only ever points to older ones, and no write barrier is needed to know that
+// old objects don't reach young ones. A minor collection, due once the
+// nursery is full, traces and sweeps only the objects made since the last
+// collection, and the survivors become old. A full one, due once the live
+// bytes reach a limit that grows with what survived the last, takes them all.
+//
+// Objects are carved out of aligned pages that the heap owns, each of slots of
+// a single size, reused once their objects are freed. Pages left empty by a
+// collection are released. The page of a pointer tells whether it's one of
+// the heap's, without looking at what it points to.
+struct Heap {
+	struct Options {
+		size_t threshold = 4 << 20; // live bytes before the first collection
+		double growth = 2.0;        // of the bytes surviving, before the next
+		size_t nursery = 256 << 10; // bytes made before a minor collection, 0 for none
+		bool enabled = true;        // objects are only freed with the heap otherwise
+	};
+
+	struct Stats {
+		size_t collections = 0;
+		size_t minor_collections = 0; // of the collections, of young objects only
+		size_t objects = 0;           // live
+		size_t bytes = 0;             // live, including objects not yet found dead
+		size_t allocated = 0;         // bytes ever allocated
+		size_t collected = 0;         // bytes ever freed by collections
+		size_t objects_collected = 0; // ever freed by collections
+		uint64_t pause_ns = 0;        // total time spent collecting
+		uint64_t max_pause_ns = 0;
+	};
+
+	explicit Heap(Options opts);
+	Heap() : Heap(Options {}) {}
+	~Heap();
+
+	Heap(const Heap &) = delete;
+	Heap &operator=(const Heap &) = delete;
+
+	template<typename T, typename... Args>
+	T *make(Args &&...args) {
+		constexpr size_t cls = (sizeof(Object) + sizeof(T) - 1) / slot_align;
+		static_assert(cls < class_count);
+		auto obj = new (allocate(cls)) Object;
+		T *res = new (obj + 1) T(std::forward<Args>(args)...);
+		obj->next = young;
+		obj->trace = trace_object<T>;
+		obj->destroy = [](void *p) { ((T *)p)->~T(); };
+		obj->size = sizeof(Object) + sizeof(T) + gc_extra(*res);
+		obj->marked = false;
+		obj->old = false;
+		young = obj;
+		st.objects++;
+		st.bytes += obj->size;
+		st.allocated += obj->size;
+		young_bytes += obj->size;
+		return res;
+	}
+
+	// Counts again the bytes an object owns, after it allocated more, like a
+	// rope that was flattened. Objects of other heaps are ignored.
+	template<typename T>
+	void remeasure(const T *obj) {
+		if (obj == nullptr || !owns(obj)) return;
+		Object *o = (Object *)obj - 1;
+		const size_t size = sizeof(Object) + sizeof(T) + gc_extra(*obj);
+		if (size <= o->size) return;
+		st.bytes += size - o->size;
+		st.allocated += size - o->size;
+		young_bytes += size - o->size;
+		o->size = size;
+	}
+
+	// whether enough was allocated since the last collection for another
+	bool due() const {
+		return opts.enabled
+		    && (st.bytes >= limit || (opts.nursery != 0 && young_bytes >= opts.nursery));
+	}
+
+	// Frees everything not reachable from the roots marked by mark_roots,
+	// which is called with this heap, nor from the pinned values. Only young
+	// objects are, unless a full collection is due.
+	template<typename MarkRoots>
+	void collect(MarkRoots mark_roots) {
+		begin();
+		mark_roots(*this);
+		finish();
+	}
+
+	// Takes over the objects of other, which is left empty, as if they had been
+	// made here. Neither may be in use by another thread.
+	void adopt(Heap &other);
+
+	// Marks the object as reachable, during a collection
+	void mark(const void *obj) {
+		if (obj == nullptr || !owns(obj)) return;
+		Object *o = (Object *)obj - 1;
+		// old objects only point to old ones, which a minor collection keeps
+		if (o->marked || (o->old && !full)) return;
+		o->marked = true;
+		gray.push_back(o);
+	}
+	void mark(const Value &val);
+
+	// Values that stay alive until unpinned, whoever holds them
+	void pin(const Value &val) { pinned.push_back(val); }
+	void unpin_all() { pinned.clear(); }
+
+	const Options &options() const { return opts; }
+	const Stats &stats() const { return st; }
+
+ private:
+	// precedes each object, aligned like anything new would return
+	struct alignas(std::max_align_t) Object {
+		Object *next; // of the live ones, or of the free slots of its page
+		void (*trace)(Heap &heap, const void *obj);
+		void (*destroy)(void *obj);
+		size_t size;
+		bool marked;
+		bool old; // survived a collection
+	};
+
+	// slots of class c take (c + 1) * slot_align bytes, header included
+	static constexpr size_t slot_align = alignof(Object);
+	static constexpr size_t class_count = 16;
+	static constexpr size_t page_size = 16 << 10;
+
+	// at the start of each page
+	struct alignas(std::max_align_t) Page {
+		Page *next;   // of the pages of its class with free slots
+		Object *free; // slots freed
+		char *cur;    // slots never used, up to the end of the page
+		size_t live;  // objects
+		size_t cls;
+
+		bool full() const {
+			const auto left = (size_t)((char *)this + page_size - cur);
+			return free == nullptr && left < (cls + 1) * slot_align;
+		}
+	};
+
+	Options opts;
+	Stats st;
+	size_t limit;
+	Object *young = nullptr; // made since the last collection
+	Object *old = nullptr;
+	size_t young_bytes = 0;
+	bool full = false; // of the collection in progress
+	Page *partial[class_count] = {}; // pages with free slots, by class
+	std::vector<uintptr_t> pages;    // sorted
+	std::vector<Value> pinned;
+	// during collections, the objects left to trace
+	std::vector<Object *> gray;
+	std::chrono::steady_clock::time_point started;
+
+	static Page *page_of(const void *obj) {
+		return (Page *)((uintptr_t)obj & ~(uintptr_t)(page_size - 1));
+	}
+	bool owns(const void *obj) const {
+		const auto page = (uintptr_t)page_of(obj);
+		return std::binary_search(pages.begin(), pages.end(), page);
+	}
+
+	void *allocate(size_t cls);
+	void trace_rope(const Rope &rope);
+
+	template<typename T>
+	static void trace_object(Heap &heap, const void *obj) {
+		if constexpr (std::is_same_v<T, Rope>) heap.trace_rope(*(const Rope *)obj);
+	}
+
+	void begin();
+	void finish();
+	void sweep(Object **list);
+};
+
+#endif
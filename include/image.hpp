@@ -0,0 +1,67 @@
+#ifndef ALUAR_IMAGE_HPP
+#define ALUAR_IMAGE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include "cache.hpp"
+#include "io.hpp"
+
+// Compiled image of a source file, kept next to it like a .pyc. It holds the
+// source and the trees of its forms in flat arrays addressed by offsets, so
+// loading maps the file and copies each array in one go, without parsing or
+// allocating per node, and the source is used from the mapping. Nodes are
+// only checked to stay in bounds. Only programs without syntax errors are
+// saved.
+//
+// Layout, all in native byte order:
+//   header, symbol names, then per form its header, nodes and synthetic
+//   text, and the source at the end.
+// Symbols are numbered in the image as builtins first and then the others by
+// first use, which is also the order a fresh process interns them in. Nodes
+// only need renumbering when loaded into a process that interned others.
+
+// bumped on any change to the layout, to CST::Node or to the symbols of nodes
+constexpr uint32_t image_version = 5;
+
+// how the trees were prepared, an image is only fresh if they match
+constexpr uint32_t image_folded = 1;
+// Type checked. Loading checks again rather than trust the typed marks, as
+// they drop the checks of evaluation.
+constexpr uint32_t image_checked = 2;
+
+// what identifies the version of the source an image was made from
+struct SourceStamp {
+	uint64_t size;
+	int64_t mtime_ns;
+};
+
+bool source_stamp(const std::filesystem::path &path, SourceStamp &out);
+
+// foo.al is imaged as foo.alc
+std::filesystem::path image_path(const std::filesystem::path &source);
+
+// Writes the image through a temporary file renamed into place, so readers
+// never see half of one. Returns false if it could not be written.
+bool save_image(
+	const std::filesystem::path &path,
+	std::string_view src,
+	const std::vector<Program::Form> &forms,
+	const SourceStamp &stamp,
+	uint32_t flags
+);
+
+struct Image {
+	MappedFile file;
+	std::string_view src; // in the mapping
+	std::vector<Program::Form> forms;
+
+	// Maps the image at path. Fails if it's missing, corrupt, of another
+	// version, or not made from the source with the given stamp and flags.
+	explicit Image(const std::filesystem::path &path) : file {path} {}
+	bool load(const SourceStamp &stamp, uint32_t flags);
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef ALUAR_INTERPRETER_HPP
+#define ALUAR_INTERPRETER_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cache.hpp"
+#include "eval.hpp"
+#include "gc.hpp"
+#include "parse.hpp"
+#include "vm.hpp"
+
+// Interpreter context for embedding. It owns the values it makes, collecting
+// the garbage among them, and the buffers reused between evaluations. A context must only be used by one
+// thread at a time, but any number of them may run concurrently, as the
+// symbol table and the builtins are shared and safe to use from many threads.
+struct Interpreter {
+	struct Options {
+		bool vm = false;            // run on the bytecode VM instead of the tree
+		bool fold = false;          // fold constant applications first
+		bool typecheck = true;      // reject ill-typed forms before running them
+		std::string *out = nullptr; // where put and println write, or stdout
+		// Programs are taken from the cache, which may be shared by contexts,
+		// instead of parsed on every call. Its own options decide on checking,
+		// folding and compiling.
+		ProgramCache *cache = nullptr;
+		Heap::Options gc {}; // tuning of the heap of the context
+	};
+
+	explicit Interpreter(Options opts);
+	Interpreter() : Interpreter(Options {}) {}
+
+	Interpreter(const Interpreter &) = delete;
+	Interpreter &operator=(const Interpreter &) = delete;
+
+	// Evaluates the top-level forms of src in order, stopping at the first
+	// error, and returns the value of the last one. On a syntax or type error
+	// the result is an error value and the errors are kept in errors(). Strings in
+	// the result stay valid until the next reset.
+	Value eval(std::string_view src);
+
+	const std::vector<SyntaxError> &errors() const { return tree.errors; }
+
+	// Releases every value returned so far. Buffers are kept for reuse.
+	void reset();
+
+	const Heap::Stats &gc_stats() const { return heap.stats(); }
+
+ private:
+	Options opts;
+	// Values made while evaluating, collected as they go. The ones returned
+	// are pinned until the next reset.
+	Heap heap;
+	CST tree;
+	Bytecode code;
+};
+
+#endif
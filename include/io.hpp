@@ -2,12 +2,92 @@
 #define ALUAR_IO_HPP
 
 #include <filesystem>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "eval.hpp"
+#include "lex.hpp"
+#include "parse.hpp"
 
-void print_str(const std::string &src);
-std::string read_file(std::filesystem::path path);
+// Read-only contents of a file. Regular files are memory mapped so the source
+// is never copied, anything else (pipes, empty files) is read into a buffer.
+struct MappedFile {
+	MappedFile(const std::filesystem::path &path);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	std::string_view text() const { return view; }
+	// whether the file could be read at all
+	bool ok() const { return opened; }
+
+ private:
+	bool opened = true;
+	void *map = nullptr;
+	size_t map_len = 0;
+	std::string buf;
+	std::string_view view;
+};
+
+// reads from a file descriptor, for streaming input such as pipes
+TokenStream::Reader fd_reader(int fd);
+
+// Buffered writer to a file descriptor. Small pieces are gathered in a large
+// buffer and written together, larger ones are written right away along with
+// what was buffered. Writes take a lock, unless unlocked by a program that
+// only ever prints from one thread.
+struct OutSink {
+	explicit OutSink(int fd, size_t capacity = 256 * 1024);
+	~OutSink();
+
+	OutSink(const OutSink &) = delete;
+	OutSink &operator=(const OutSink &) = delete;
+
+	void write(std::string_view s);
+	void flush();
+	// flushes, then writes to fd from now on
+	void redirect(int fd);
+	void set_locking(bool on) { locking = on; }
+
+ private:
+	int fd;
+	std::vector<char> buf;
+	size_t used = 0;
+	bool locking = true;
+	std::mutex mutex;
+
+	void write_unlocked(std::string_view s);
+	void flush_unlocked();
+};
+
+// where everything printed goes, flushed on exit
+OutSink &stdout_sink();
+
+// Output of the print functions, and so of put and println, goes to the stdout
+// sink unless the calling thread captures it, by appending to buf. Null stops it.
+// Returns the previous buffer, to be restored afterwards.
+std::string *capture_output(std::string *buf);
+
+void print_str(std::string_view src);
+// prints the pieces of the rope, without flattening it
+void print_rope(const Rope &rope);
+void print_fmt(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+// prints src as a quoted JSON string
+void print_json_str(std::string_view src);
+// Prints syntax errors as name:line:col: message. The source starts at
+// first_column of first_line, and name is left out if empty.
+void print_errors(
+	std::string_view name,
+	const CST &tree,
+	std::string_view src,
+	size_t first_line = 1,
+	size_t first_column = 1
+);
+// prints the tree in prefix form, quoting symbols and numbers
+void print_tree(const CST &tree, std::string_view src);
 void print_value(const Value &val);
 
 #endif
@@ -1,10 +1,15 @@
 #ifndef ALUAR_LEX_HPP
 #define ALUAR_LEX_HPP
 
+#include <cstdint>
 #include <cstdlib>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "symbol.hpp"
+
 struct Token {
 	enum class Type {
 		Plus,
@@ -33,13 +38,66 @@ struct Token {
 		SingleQuote,
 		Spaces,
 		Tabs,
+		Unknown, // a character that doesn't start any token
 	};
 
 	size_t beg;
 	size_t len;
 	Type type;
+	SymbolId sym = UINT32_MAX; // interned text of words, no id otherwise
 };
 
-std::vector<Token> tokenize(std::string src);
+// Tokens the parser takes as symbols, operators included. All of them are
+// interned, so that none keeps the id of the first builtin.
+bool is_word(const Token &tk);
+// Whitespace tokens, which the parser and the token stream skip
+bool is_space(const Token &tk);
+
+// Words are interned as they are lexed, so that nothing after the lexer needs
+// their text to tell them apart.
+std::vector<Token> tokenize(std::string_view src);
+
+// Pull-based lexer. Tokens are lexed on demand, reading more input only when
+// the buffered source runs out, and whitespace is skipped. Positions of tokens
+// are relative to text(), which holds the source since the last discard().
+struct TokenStream {
+	// Reads at most cap bytes into buf and returns the number read, zero at the
+	// end of input.
+	using Reader = std::function<size_t(char *buf, size_t cap)>;
+
+	// whole source in memory
+	TokenStream(std::string_view src);
+	// chunked input, with memory bounded by the longest top-level form
+	TokenStream(Reader reader, size_t chunk_size = 64 * 1024);
+
+	// false at the end of input
+	bool peek(Token &tk);
+	bool next(Token &tk);
+
+	std::string_view text() const { return src; }
+	// line of the input text() starts in, counting from 1
+	size_t line() const { return first_line; }
+	// column of that line text() starts at, counting from 1
+	size_t column() const { return first_column; }
+	// Drops the source before the next token and rebases positions on it.
+	void discard();
+
+ private:
+	Reader reader;
+	size_t chunk_size = 0;
+	std::string buf; // chunks read so far
+	size_t start = 0; // of the source still in use in buf
+	bool eof = false;
+
+	std::string_view src;
+	size_t first_line = 1;
+	size_t first_column = 1;
+	size_t pos = 0; // where lexing resumes
+	Token ahead;
+	bool peeked = false;
+
+	bool refill();
+	bool lex(Token &tk);
+};
 
 #endif
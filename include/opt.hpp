@@ -0,0 +1,22 @@
+#ifndef ALUAR_OPT_HPP
+#define ALUAR_OPT_HPP
+
+#include <cstdlib>
+#include <string_view>
+
+#include "parse.hpp"
+
+struct FoldStats {
+	size_t folded;  // applications replaced by their value
+	size_t merged;  // string literals merged into a neighbour by cat
+	size_t removed; // nodes no longer reachable from the root
+};
+
+// Constant folding. Applications of pure builtins over literal arguments are
+// replaced by literals of their value, and adjacent string literals given to
+// cat are concatenated ahead of time, as long as the results stay small.
+// Applications that would fail are left in place, so the error still happens
+// at run time, in order.
+FoldStats fold_constants(CST &tree, std::string_view src);
+
+#endif
@@ -1,15 +1,28 @@
 #ifndef ALUAR_PARSE_HPP
 #define ALUAR_PARSE_HPP
 
+#include <cstdint>
 #include <cstdlib>
 #include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "lex.hpp"
+#include "symbol.hpp"
 
-// Concrete Syntax Tree
+// Error of a tree, found by the parser or by check_types
+struct SyntaxError {
+	size_t beg; // position in the source
+	std::string msg;
+};
+
+// Concrete Syntax Tree. All nodes of a parse live in one flat array, which
+// is freed at once with the tree.
 struct CST {
-	enum class Type {
+	using Index = uint32_t;
+
+	enum class Type : uint8_t {
 		App,
 		Number,
 		Symbol,
@@ -19,21 +32,42 @@ struct CST {
 
 	struct Node {
 		size_t beg;
-		size_t len;
+		size_t len; // of applications, up to and including the closing paren
 		Type type;
-		std::vector<Node *> children;
-
-		~Node() {
-			for (auto c : children) delete c;
-		}
+		bool synthetic; // literal made by the optimizer, its text is in text
+		bool typed;     // application whose arguments check_types proved right
+		SymbolId sym;   // interned name of symbols
+		Index first;  // children are nodes[first, first + count)
+		Index count;
 	};
 
-	Node *root;
-	bool success;
+	std::vector<Node> nodes;
+	Index root;
+	std::string text; // of synthetic literals
+	// The parser recovers from errors, so that all of them are reported in one
+	// pass, in source order. The tree is only meant to be evaluated if there are
+	// none.
+	std::vector<SyntaxError> errors;
+
+	bool success() const { return errors.empty(); }
 
-	~CST() { delete root; }
+	const Node &root_node() const { return nodes[root]; }
+	std::string_view text_of(const Node &node, std::string_view src) const {
+		return (node.synthetic ? std::string_view(text) : src)
+		  .substr(node.beg, node.len);
+	}
+	std::span<const Node> children(const Node &node) const {
+		return {nodes.data() + node.first, node.count};
+	}
 };
 
-CST parse(const std::span<Token> &tks);
+// Parses a program made of a single node. Parsing uses constant native stack,
+// regardless of nesting depth and width.
+CST parse(const std::span<Token> &tks, std::string_view src);
+
+// Parses the next top-level form of the stream into tree, reusing its memory.
+// The source of the previous form is discarded first. Returns false at the end
+// of input.
+bool parse_form(TokenStream &tks, CST &tree);
 
 #endif
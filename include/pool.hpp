@@ -0,0 +1,62 @@
+#ifndef ALUAR_POOL_HPP
+#define ALUAR_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join thread pool with work stealing. Every thread owns a queue, takes
+// its own tasks newest first and steals the oldest ones from the others.
+// Threads waiting on a group run queued tasks meanwhile, so tasks may spawn
+// and wait on tasks of their own.
+struct Pool {
+	using Func = void(void *arg);
+
+	// tasks that are waited on together
+	struct Group {
+		std::atomic<size_t> pending = 0;
+	};
+
+	// threads counts the calling thread, which works while it waits
+	explicit Pool(size_t threads);
+	~Pool();
+
+	Pool(const Pool &) = delete;
+	Pool &operator=(const Pool &) = delete;
+
+	size_t threads() const { return queues.size(); }
+
+	void spawn(Group &group, Func *func, void *arg);
+	void wait(Group &group);
+
+ private:
+	struct Task {
+		Func *func;
+		void *arg;
+		Group *group;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	size_t self() const;
+	bool take(size_t self, Task &task);
+	void work(size_t self);
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	std::atomic<size_t> queued = 0;
+	std::mutex sleep;
+	std::condition_variable wake;
+	bool stop = false;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef ALUAR_PROFILE_HPP
+#define ALUAR_PROFILE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "symbol.hpp"
+
+// Built-in profiler. It's always compiled in and off unless enabled, and then
+// every instrumented point only pays a check of a flag. On, the phases of a
+// run are timed wherever they happen, with the allocations they made, along
+// with every application of a builtin and the source span it came from.
+
+enum class Phase : uint8_t {
+	Tokenize,
+	Parse,
+	Check,
+	Fold,
+	Compile,
+	Eval,
+	Print,
+};
+
+constexpr size_t phase_count = (size_t)Phase::Print + 1;
+
+// whether profiling is on, set before any thread runs and read without locks
+extern bool profile_on;
+
+inline bool profiling() { return profile_on; }
+
+// Counts an allocation. The library doesn't replace operator new, so it's up
+// to the program to count them, see alloc.hpp.
+void profile_alloc(size_t bytes);
+
+// Times the enclosing scope as the given phase. Time and allocations of phases
+// nested in it are only counted in the inner one.
+struct ProfileScope {
+	explicit ProfileScope(Phase phase) {
+		if (profiling()) [[unlikely]] begin(phase);
+	}
+	~ProfileScope() {
+		if (active) [[unlikely]] end();
+	}
+
+	ProfileScope(const ProfileScope &) = delete;
+	ProfileScope &operator=(const ProfileScope &) = delete;
+
+ private:
+	bool active = false;
+	Phase phase;
+	std::chrono::steady_clock::time_point start;
+	uint64_t start_allocs;
+	uint64_t start_bytes;
+	ProfileScope *parent;
+	uint64_t nested_ns = 0;
+	uint64_t nested_allocs = 0;
+	uint64_t nested_bytes = 0;
+
+	void begin(Phase phase);
+	void end();
+};
+
+using ProfileClock = std::chrono::steady_clock;
+
+inline uint64_t profile_ns_since(ProfileClock::time_point start) {
+	const auto d = ProfileClock::now() - start;
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+// Records an application of a builtin that took ns, from the span of len
+// bytes at span in the source, if known.
+void profile_apply(SymbolId func, const char *span, size_t len, uint64_t ns);
+
+// Gives the spans recorded so far within text their positions in file, where
+// text starts at the given column of the given line. Called after evaluating
+// text, while it's still alive, as spans are recorded by address.
+void profile_spans(
+	std::string_view file, std::string_view text, size_t line = 1, size_t column = 1
+);
+
+// prints the report, human readable
+void print_profile();
+// Writes the report as JSON in the Chrome trace format, with the phases as
+// events and the rest under "profile". Returns false if it couldn't be written.
+bool write_profile(const std::string &path);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef ALUAR_ROPE_HPP
+#define ALUAR_ROPE_HPP
+
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Immutable string built by concatenation. Concatenating links both sides
+// instead of copying them, so a chain of them is linear in the total length.
+// The text is only gathered into one buffer when flat() asks for it.
+struct Rope {
+	// leaf holding a copy of text
+	explicit Rope(std::string_view text);
+	// Concatenation of both, which must outlive it. Short results are copied
+	// into a leaf instead, so that small strings don't grow deep trees.
+	Rope(const Rope *left, const Rope *right);
+
+	size_t size() const { return len; }
+
+	// The whole text. Flattens a concatenation on first use and keeps the
+	// result, so it must not be called on the same rope from two threads.
+	std::string_view flat() const;
+
+	// Calls visit with each piece of the text in order, without flattening.
+	template<typename Visit>
+	void for_each_piece(Visit visit) const {
+		if (is_flat()) {
+			visit(std::string_view(text));
+			return;
+		}
+		// explicit stack, since chains of concatenations can be very deep
+		std::vector<const Rope *> stack {this};
+		while (!stack.empty()) {
+			const Rope *r = stack.back();
+			stack.pop_back();
+			if (r->is_flat()) {
+				if (r->len != 0) visit(std::string_view(r->text));
+				continue;
+			}
+			stack.push_back(r->right);
+			stack.push_back(r->left);
+		}
+	}
+
+	// The ropes this one still reads from, both null for leaves and for
+	// concatenations already flattened
+	std::pair<const Rope *, const Rope *> links() const {
+		if (is_flat()) return {nullptr, nullptr};
+		return {left, right};
+	}
+
+	// concatenations shorter than this are copied into a leaf
+	static constexpr size_t min_concat = 64;
+
+ private:
+	size_t len;
+	const Rope *left = nullptr; // both null for leaves
+	const Rope *right = nullptr;
+	mutable std::string text; // of leaves, and of concatenations once flat
+	mutable bool flattened = false;
+
+	bool is_flat() const { return left == nullptr || flattened; }
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef ALUAR_SCAN_HPP
+#define ALUAR_SCAN_HPP
+
+#include <cstdlib>
+#include <string_view>
+
+// Byte classes the lexer scans runs of
+enum class ScanClass {
+	Space,    // ' '
+	Tab,      // '\t'
+	Alpha,    // [a-zA-Z]
+	Digit,    // [0-9]
+	NotQuote, // anything but '"'
+};
+
+// Instruction sets the scanners can use, from slowest to fastest
+enum class ScanIsa {
+	Scalar,
+	SSE2,
+	AVX2,
+};
+
+// Length of the run at the start of src of bytes in the given class.
+size_t scan(ScanClass cls, std::string_view src);
+
+// The best instruction set supported by the CPU is picked at startup. Setting
+// it is only meant for benchmarks, and is clamped to what the CPU supports.
+ScanIsa scan_isa();
+void set_scan_isa(ScanIsa isa);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef ALUAR_SYMBOL_HPP
+#define ALUAR_SYMBOL_HPP
+
+#include <cstdint>
+#include <string_view>
+
+// Interned symbol. Equal names always get the same id.
+using SymbolId = uint32_t;
+
+// Builtin functions. Their names are interned before any other symbol, so the
+// id of a builtin name is also its slot in the builtin table.
+enum class Builtin : SymbolId {
+	Add,
+	Sub,
+	Mul,
+	Div,
+	Shl,
+	Shr,
+	Cat,
+	Put,
+	And,
+	Or,
+	Xor,
+	Not,
+	Println,
+};
+
+const SymbolId builtin_count = (SymbolId)Builtin::Println + 1;
+
+// Thread-safe, ids stay valid for the whole process
+SymbolId intern(std::string_view name);
+std::string_view symbol_name(SymbolId sym);
+
+// What the interned symbols cost, against keeping a string per reference
+struct SymbolStats {
+	size_t unique;      // symbols interned
+	size_t table_bytes; // of their names and the index over them
+	size_t references;  // calls to intern, one per word lexed or loaded
+	size_t string_bytes; // that the references would take as std::strings
+	size_t saved_bytes;  // by the table and 32-bit ids instead of those strings
+};
+
+SymbolStats symbol_stats();
+
+inline bool is_builtin(SymbolId sym) { return sym < builtin_count; }
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef ALUAR_TYPES_HPP
+#define ALUAR_TYPES_HPP
+
+#include "parse.hpp"
+
+// Infers the type of every node of a parsed tree. Applications that would
+// certainly fail, for calling an unknown function or passing arguments of the
+// wrong type or number, are added to the errors of the tree in source order.
+// The others are marked typed, so that the evaluators apply their builtins
+// without checking the arguments again. Returns whether the tree is well
+// typed. Trees with syntax errors are left as they are. The source is the
+// one the tree was parsed from, to name unknown functions.
+bool check_types(CST &tree, std::string_view src);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef ALUAR_VM_HPP
+#define ALUAR_VM_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bigint.hpp"
+#include "eval.hpp"
+#include "parse.hpp"
+#include "rope.hpp"
+
+// Linear stack machine code lowered from a CST
+struct Bytecode {
+	enum class Op : uint8_t {
+		Num,  // push nums[arg]
+		Big,  // push bigs[arg]
+		Str,  // push lits[arg]
+		Sym,  // push symbol arg
+		Call, // pop arg values, apply builtin slot to them and push the result
+		// the same for applications check_types proved right, without the checks
+		TypedCall,
+		// typed application of add, sub or mul to two numbers, kept inline
+		Add,
+		Sub,
+		Mul,
+		Fail, // stop with error message strs[arg]
+		Ret,  // stop with the value on top of the stack
+	};
+
+	struct Instr {
+		Op op;
+		uint8_t slot;
+		uint32_t arg;
+	};
+
+	std::vector<Instr> code;
+	std::vector<int64_t> nums;
+	std::vector<BigInt> bigs; // literals too large for nums
+	std::vector<Rope> lits;        // string literals
+	std::vector<std::string> strs; // error messages
+	size_t max_stack;
+};
+
+Bytecode compile(const CST &tree, std::string_view src);
+
+// String and bigint values may point into the constant pool of the bytecode,
+// so it must outlive the result.
+Value run(const Bytecode &code);
+
+#endif
@@ -0,0 +1,30 @@
+#include "alloc.hpp"
+
+#include <cstdlib>
+#include <new>
+
+static AllocHook alloc_hook = nullptr;
+
+void set_alloc_hook(AllocHook hook) { alloc_hook = hook; }
+
+void *operator new(size_t sz, const std::nothrow_t &) noexcept {
+	if (alloc_hook != nullptr) alloc_hook(sz);
+	return std::malloc(sz == 0 ? 1 : sz);
+}
+
+void *operator new(size_t sz) {
+	if (void *p = operator new(sz, std::nothrow)) return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t sz) { return operator new(sz); }
+void *operator new[](size_t sz, const std::nothrow_t &) noexcept {
+	return operator new(sz, std::nothrow);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
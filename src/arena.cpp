@@ -0,0 +1,60 @@
+#include "arena.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+Arena::Arena(size_t chunk_size) : chunk_size {chunk_size} {}
+
+Arena::~Arena() {
+	finalize();
+	while (chunk != nullptr) {
+		Chunk *prev = chunk->prev;
+		std::free(chunk);
+		chunk = prev;
+	}
+}
+
+void *Arena::alloc(size_t size, size_t align) {
+	auto p = ((uintptr_t)cur + align - 1) & ~(uintptr_t)(align - 1);
+	if (cur == nullptr || p + size > (uintptr_t)end) {
+		// big allocations get a chunk of their own
+		const size_t cap = size + align > chunk_size ? size + align : chunk_size;
+		auto c = (Chunk *)std::malloc(sizeof(Chunk) + cap);
+		if (c == nullptr) throw std::bad_alloc();
+		c->prev = chunk;
+		c->size = cap;
+		chunk = c;
+		cur = (char *)(c + 1);
+		end = cur + cap;
+		p = ((uintptr_t)cur + align - 1) & ~(uintptr_t)(align - 1);
+	}
+	cur = (char *)(p + size);
+	used_bytes += size;
+	return (void *)p;
+}
+
+void Arena::on_release(void (*fn)(void *), void *obj) {
+	auto f = (Finalizer *)alloc(sizeof(Finalizer), alignof(Finalizer));
+	*f = Finalizer {fn, obj, finalizers};
+	finalizers = f;
+}
+
+void Arena::finalize() {
+	// reverse order of construction
+	for (Finalizer *f = finalizers; f != nullptr; f = f->prev) f->fn(f->obj);
+	finalizers = nullptr;
+}
+
+void Arena::reset() {
+	finalize();
+	if (chunk == nullptr) return;
+	while (chunk->prev != nullptr) {
+		Chunk *prev = chunk->prev;
+		std::free(chunk);
+		chunk = prev;
+	}
+	cur = (char *)(chunk + 1);
+	end = cur + chunk->size;
+	used_bytes = 0;
+}
@@ -4,22 +4,113 @@ namespace AST {
 
 void AST::AST::interpret() { root = root->reduce(env); }
 
+const Node* App::enter(Env& env, const Node*& res) const {
+	if (children.size() < 1) {
+		res = env.make<Error>("Empty application");
+		return nullptr;
+	}
+
+	const Node* fst = children[0];
+	if (fst->type() != Type::Symbol) {
+		res = env.make<Error>("Application first value must be a symbol");
+		return nullptr;
+	}
+
+	const Symbol* func_ident = static_cast<const Symbol*>(fst);
+
+	const Node* sym_val = env.lookup(func_ident->id);
+
+	// func not in env
+	if (sym_val == nullptr) {
+		res = env.make<Error>("Symbol doesn't refer to any value");
+		return nullptr;
+	}
+
+	if (sym_val->type() != Type::Arrow) {
+		res = env.make<Error>("Symbol does not refer to an arrow");
+		return nullptr;
+	}
+
+	const Builtin* arrow = static_cast<const Builtin*>(sym_val);
+
+	if ((children.size() - 1) != arrow->arg_list().size()) {
+		res = env.make<Error>("Wrong number of arguments");
+		return nullptr;
+	}
+
+	// arguments are reduced onto the stack, in the slots of their parameters,
+	// and then become the frame of the callee
+	env.calls.push_back(Call {this, arrow, env.stack.size(), 1});
+	if (children.size() > 1) return children[1];
+	res = nullptr;
+	return nullptr;
+}
+
+const Node* App::reduce(Env& env) const {
+	// calls below this one belong to whoever is reducing us
+	const size_t floor = env.calls.size();
+
+	const Node* next = this;
+	const Node* val = nullptr;
+	while (true) {
+		while (next != nullptr) {
+			if (next->type() == Type::App) {
+				next = static_cast<const App*>(next)->enter(env, val);
+			} else {
+				val = next->reduce(env);
+				next = nullptr;
+			}
+		}
+
+		if (env.calls.size() == floor) return val;
+		Call& call = env.calls.back();
+		// errors abort every call waiting for them, like in the other evaluators
+		if (val != nullptr && val->type() == Type::Error) {
+			env.stack.resize(call.base);
+			env.calls.pop_back();
+			continue;
+		}
+		// a call without arguments is ready as soon as it is entered
+		if (call.next < call.app->children.size()) {
+			env.stack.push_back(val);
+			if (++call.next < call.app->children.size()) {
+				next = call.app->children[call.next];
+				continue;
+			}
+		}
+
+		const Call done = call;
+		const size_t caller = env.frame;
+		env.frame = done.base;
+		val = done.arrow->impl(env);
+		env.frame = caller;
+		env.stack.resize(done.base);
+		env.calls.pop_back();
+
+		if (env.heap != nullptr && env.heap->due())
+			env.heap->collect([&](Heap& heap) {
+				for (auto node : env.globals) heap.mark(node);
+				for (auto node : env.stack) heap.mark(node);
+				heap.mark(val);
+			});
+	}
+}
+
 const Node* add(Env& env);
 const Node* sub(Env& env);
 const Node* mul(Env& env);
 const Node* div(Env& env);
 
 // scoped macro
-// FIXME calee can override environment of caller function, messing things up.
-// Create a unique hole punching system for sanitizing variable names
-#define PUSH_BINARY_OP(FUNC, IDENT)       \
-	b = new Builtin(FUNC);                  \
-	b->children.push_back(new Symbol("x")); \
-	b->children.push_back(new Symbol("y")); \
-	env[Symbol(IDENT)] = b;
+#define PUSH_BINARY_OP(FUNC, IDENT)   \
+	params = arena.array<Node*>(2);     \
+	params[0] = arena.make<Symbol>("x"); \
+	params[1] = arena.make<Symbol>("y"); \
+	env.define(intern(IDENT), arena.make<Builtin>(FUNC, params));
 
 AST::AST() {
-	Builtin* b = nullptr;
+	std::span<Node*> params;
+	env.heap = &heap;
 
 	PUSH_BINARY_OP(add, "+");
 	PUSH_BINARY_OP(sub, "-");
@@ -29,19 +120,62 @@ AST::AST() {
 
 #undef PUSH_BINARY_OP
 
+static bool is_number(const Node* node) {
+	return node->type() == Type::Number || node->type() == Type::BigNumber;
+}
+
+static BigInt big_of(const Node* num) {
+	if (num->type() == Type::Number)
+		return BigInt(static_cast<const Number*>(num)->val);
+	return static_cast<const BigNumber*>(num)->val;
+}
+
+// results that fit 64 bits go back to Numbers
+static const Node* make_number(Env& env, BigInt val) {
+	int64_t small;
+	if (val.to_int(small)) return env.make<Number>(small);
+	return env.make<BigNumber>(std::move(val));
+}
+
 // scoped macro
-#define DEF_BINARY_OP(FUNC, OP)                        \
-	const Node* FUNC(Env& env) {                         \
-		const Number* x = (const Number*)env[Symbol("x")]; \
-		const Number* y = (const Number*)env[Symbol("y")]; \
-		return new Number(x->val OP y->val);               \
+// parameters x and y are in slots 0 and 1. CHECK stores the result of small
+// numbers and tells whether it overflowed, in which case OP promotes it.
+#define DEF_BINARY_OP(FUNC, CHECK, OP)                            \
+	const Node* FUNC(Env& env) {                                    \
+		const Node* x = env.arg(0);                                   \
+		const Node* y = env.arg(1);                                   \
+		if (!is_number(x) || !is_number(y))                           \
+			return env.make<Error>("Type Error: expected Number");      \
+		int64_t res;                                                  \
+		if (x->type() == Type::Number && y->type() == Type::Number    \
+		    && !CHECK(static_cast<const Number*>(x)->val,             \
+		              static_cast<const Number*>(y)->val, &res))     \
+			return env.make<Number>(res);                               \
+		return make_number(env, big_of(x) OP big_of(y));              \
 	}
 
-DEF_BINARY_OP(sub, -);
-DEF_BINARY_OP(add, +);
-DEF_BINARY_OP(mul, *);
-DEF_BINARY_OP(div, /);
+DEF_BINARY_OP(sub, __builtin_sub_overflow, -);
+DEF_BINARY_OP(add, __builtin_add_overflow, +);
+DEF_BINARY_OP(mul, __builtin_mul_overflow, *);
 
 #undef DEF_BINARY_OP
 
+// fails differently by zero, like the other evaluators
+const Node* div(Env& env) {
+	const Node* x = env.arg(0);
+	const Node* y = env.arg(1);
+	if (!is_number(x) || !is_number(y))
+		return env.make<Error>("Type Error: expected Number");
+	// bigints are never zero
+	if (y->type() == Type::Number) {
+		const int64_t d = static_cast<const Number*>(y)->val;
+		if (d == 0) return env.make<Error>("Division by zero");
+		// the only quotient of small numbers that does not fit
+		if (x->type() == Type::Number
+		    && !(static_cast<const Number*>(x)->val == INT64_MIN && d == -1))
+			return env.make<Number>(static_cast<const Number*>(x)->val / d);
+	}
+	return make_number(env, big_of(x) / big_of(y));
+}
+
 } // namespace AST
@@ -0,0 +1,419 @@
+#include "bigint.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+__extension__ typedef unsigned __int128 u128;
+using Limbs = std::vector<uint64_t>;
+
+// largest power of ten in a limb, and its number of digits
+static constexpr uint64_t chunk_base = 10'000'000'000'000'000'000u;
+static constexpr size_t chunk_digits = 19;
+
+static void trim(Limbs &a) {
+	while (!a.empty() && a.back() == 0) a.pop_back();
+}
+
+BigInt::BigInt(int64_t n) {
+	neg = n < 0;
+	// negating the most negative number would overflow
+	const uint64_t m = neg ? (uint64_t)(-(n + 1)) + 1 : (uint64_t)n;
+	if (m != 0) mag.push_back(m);
+}
+
+bool BigInt::to_int(int64_t &out) const {
+	if (mag.size() > 1) return false;
+	const uint64_t m = mag.empty() ? 0 : mag[0];
+	if (!neg) {
+		if (m > (uint64_t)INT64_MAX) return false;
+		out = (int64_t)m;
+	} else {
+		if (m > (uint64_t)INT64_MAX + 1) return false;
+		out = (int64_t)(0 - m);
+	}
+	return true;
+}
+
+static int cmp_mag(const Limbs &a, const Limbs &b) {
+	if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+	for (size_t i = a.size(); i-- > 0;)
+		if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+	return 0;
+}
+
+static Limbs add_mag(const Limbs &a, const Limbs &b) {
+	const Limbs &l = a.size() >= b.size() ? a : b;
+	const Limbs &s = a.size() >= b.size() ? b : a;
+	Limbs res(l.size() + 1);
+	uint64_t carry = 0;
+	for (size_t i = 0; i < l.size(); i++) {
+		const u128 sum = (u128)l[i] + (i < s.size() ? s[i] : 0) + carry;
+		res[i] = (uint64_t)sum;
+		carry = (uint64_t)(sum >> 64);
+	}
+	res[l.size()] = carry;
+	trim(res);
+	return res;
+}
+
+// a - b, where a is at least b
+static Limbs sub_mag(const Limbs &a, const Limbs &b) {
+	Limbs res(a.size());
+	uint64_t borrow = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		const uint64_t y = i < b.size() ? b[i] : 0;
+		const u128 diff = (u128)a[i] - y - borrow;
+		res[i] = (uint64_t)diff;
+		borrow = (uint64_t)(diff >> 127);
+	}
+	trim(res);
+	return res;
+}
+
+// adds b shifted by the given number of limbs into a, which is large enough
+static void add_into(Limbs &a, const Limbs &b, size_t shift) {
+	uint64_t carry = 0;
+	size_t i = 0;
+	for (; i < b.size(); i++) {
+		const u128 sum = (u128)a[i + shift] + b[i] + carry;
+		a[i + shift] = (uint64_t)sum;
+		carry = (uint64_t)(sum >> 64);
+	}
+	for (i += shift; carry != 0; i++) {
+		const u128 sum = (u128)a[i] + carry;
+		a[i] = (uint64_t)sum;
+		carry = (uint64_t)(sum >> 64);
+	}
+}
+
+static Limbs mul_schoolbook(const Limbs &a, const Limbs &b) {
+	Limbs res(a.size() + b.size());
+	for (size_t i = 0; i < a.size(); i++) {
+		uint64_t carry = 0;
+		for (size_t j = 0; j < b.size(); j++) {
+			const u128 p = (u128)a[i] * b[j] + res[i + j] + carry;
+			res[i + j] = (uint64_t)p;
+			carry = (uint64_t)(p >> 64);
+		}
+		res[i + b.size()] = carry;
+	}
+	trim(res);
+	return res;
+}
+
+static Limbs mul_mag(const Limbs &a, const Limbs &b);
+
+// Splits both at half the longer one: a = a1 B^m + a0 and b = b1 B^m + b0,
+// then a b = z2 B^2m + (z1 - z2 - z0) B^m + z0, where z1 = (a0 + a1)(b0 + b1),
+// which takes three half-sized products instead of four.
+static Limbs mul_karatsuba(const Limbs &a, const Limbs &b) {
+	const size_t m = std::max(a.size(), b.size()) / 2;
+	const auto lo = [m](const Limbs &x) {
+		Limbs res(x.begin(), x.begin() + (long)std::min(m, x.size()));
+		trim(res);
+		return res;
+	};
+	const auto hi = [m](const Limbs &x) {
+		return x.size() > m ? Limbs(x.begin() + (long)m, x.end()) : Limbs {};
+	};
+	const Limbs a0 = lo(a), a1 = hi(a), b0 = lo(b), b1 = hi(b);
+
+	const Limbs z0 = mul_mag(a0, b0);
+	const Limbs z2 = mul_mag(a1, b1);
+	Limbs z1 = mul_mag(add_mag(a0, a1), add_mag(b0, b1));
+	z1 = sub_mag(sub_mag(z1, z0), z2);
+
+	Limbs res(a.size() + b.size() + 1);
+	add_into(res, z0, 0);
+	add_into(res, z1, m);
+	add_into(res, z2, 2 * m);
+	trim(res);
+	return res;
+}
+
+static Limbs mul_mag(const Limbs &a, const Limbs &b) {
+	if (a.empty() || b.empty()) return {};
+	if (std::min(a.size(), b.size()) < karatsuba_threshold) return mul_schoolbook(a, b);
+	return mul_karatsuba(a, b);
+}
+
+// divides a in place by a single limb and returns the remainder
+static uint64_t divmod_limb(Limbs &a, uint64_t d) {
+	u128 rem = 0;
+	for (size_t i = a.size(); i-- > 0;) {
+		const u128 cur = (rem << 64) | a[i];
+		a[i] = (uint64_t)(cur / d);
+		rem = cur % d;
+	}
+	trim(a);
+	return (uint64_t)rem;
+}
+
+static Limbs shl_mag(const Limbs &a, size_t bits) {
+	if (a.empty()) return {};
+	const size_t limbs = bits / 64, rest = bits % 64;
+	Limbs res(a.size() + limbs + 1);
+	for (size_t i = 0; i < a.size(); i++) {
+		res[i + limbs] |= a[i] << rest;
+		if (rest != 0) res[i + limbs + 1] = a[i] >> (64 - rest);
+	}
+	trim(res);
+	return res;
+}
+
+static Limbs shr_mag(const Limbs &a, size_t bits) {
+	const size_t limbs = bits / 64, rest = bits % 64;
+	if (limbs >= a.size()) return {};
+	Limbs res(a.size() - limbs);
+	for (size_t i = 0; i < res.size(); i++) {
+		res[i] = a[i + limbs] >> rest;
+		if (rest != 0 && i + limbs + 1 < a.size()) res[i] |= a[i + limbs + 1] << (64 - rest);
+	}
+	trim(res);
+	return res;
+}
+
+// Long division of Knuth's algorithm D, with two limb estimates of each
+// quotient limb. b has at least two limbs and a is at least b.
+static Limbs div_knuth(const Limbs &a, const Limbs &b) {
+	// normalized so that the top bit of the divisor is set
+	const auto s = (size_t)std::countl_zero(b.back());
+	const Limbs v = shl_mag(b, s);
+	Limbs u = shl_mag(a, s);
+	u.resize(a.size() + 1);
+	const size_t n = v.size(), m = u.size() - n;
+	Limbs q(m);
+
+	for (size_t j = m; j-- > 0;) {
+		const u128 num = ((u128)u[j + n] << 64) | u[j + n - 1];
+		u128 qhat = num / v[n - 1];
+		u128 rhat = num % v[n - 1];
+		while (qhat >> 64 != 0 || qhat * v[n - 2] > ((rhat << 64) | u[j + n - 2])) {
+			qhat--;
+			rhat += v[n - 1];
+			if (rhat >> 64 != 0) break;
+		}
+
+		// u -= qhat v, from limb j on
+		uint64_t carry = 0, borrow = 0;
+		for (size_t i = 0; i < n; i++) {
+			const u128 p = qhat * v[i] + carry;
+			carry = (uint64_t)(p >> 64);
+			const u128 diff = (u128)u[i + j] - (uint64_t)p - borrow;
+			u[i + j] = (uint64_t)diff;
+			borrow = (uint64_t)(diff >> 127);
+		}
+		const u128 diff = (u128)u[j + n] - carry - borrow;
+		u[j + n] = (uint64_t)diff;
+
+		// the estimate was one too large, add v back
+		if (diff >> 127 != 0) {
+			qhat--;
+			uint64_t c = 0;
+			for (size_t i = 0; i < n; i++) {
+				const u128 sum = (u128)u[i + j] + v[i] + c;
+				u[i + j] = (uint64_t)sum;
+				c = (uint64_t)(sum >> 64);
+			}
+			u[j + n] += c;
+		}
+		q[j] = (uint64_t)qhat;
+	}
+	trim(q);
+	return q;
+}
+
+static BigInt make(bool neg, Limbs mag) {
+	BigInt res;
+	res.mag = std::move(mag);
+	res.neg = neg && !res.mag.empty();
+	return res;
+}
+
+BigInt operator-(const BigInt &a) { return make(!a.neg, a.mag); }
+
+BigInt operator+(const BigInt &a, const BigInt &b) {
+	if (a.neg == b.neg) return make(a.neg, add_mag(a.mag, b.mag));
+	if (cmp_mag(a.mag, b.mag) >= 0) return make(a.neg, sub_mag(a.mag, b.mag));
+	return make(b.neg, sub_mag(b.mag, a.mag));
+}
+
+BigInt operator-(const BigInt &a, const BigInt &b) { return a + -b; }
+
+BigInt operator*(const BigInt &a, const BigInt &b) {
+	return make(a.neg != b.neg, mul_mag(a.mag, b.mag));
+}
+
+BigInt operator/(const BigInt &a, const BigInt &b) {
+	const bool neg = a.neg != b.neg;
+	if (cmp_mag(a.mag, b.mag) < 0) return BigInt {};
+	if (b.mag.size() == 1) {
+		Limbs q = a.mag;
+		divmod_limb(q, b.mag[0]);
+		return make(neg, std::move(q));
+	}
+	return make(neg, div_knuth(a.mag, b.mag));
+}
+
+BigInt operator<<(const BigInt &a, size_t bits) { return make(a.neg, shl_mag(a.mag, bits)); }
+
+BigInt operator>>(const BigInt &a, size_t bits) {
+	Limbs res = shr_mag(a.mag, bits);
+	if (a.neg) {
+		// any bit shifted out rounds the magnitude up
+		bool lost = false;
+		for (size_t i = 0; i < a.mag.size() && !lost; i++) {
+			if ((i + 1) * 64 <= bits)
+				lost = a.mag[i] != 0;
+			else if (i * 64 < bits)
+				lost = (a.mag[i] & ((uint64_t(1) << (bits % 64)) - 1)) != 0;
+		}
+		if (lost) res = add_mag(res, Limbs {1});
+	}
+	return make(a.neg, std::move(res));
+}
+
+bool BigInt::parse(std::string_view src, BigInt &out) {
+	out = BigInt {};
+	const bool negative = !src.empty() && src[0] == '-';
+	if (negative) src.remove_prefix(1);
+	if (src.empty()) return false;
+	// the first chunk takes the remainder, so the others have all the digits
+	size_t len = src.size() % chunk_digits;
+	if (len == 0) len = chunk_digits;
+	for (size_t i = 0; i < src.size(); i += len, len = chunk_digits) {
+		uint64_t chunk = 0;
+		const char *end = src.data() + i + len;
+		const auto [p, ec] = std::from_chars(src.data() + i, end, chunk);
+		if (ec != std::errc {} || p != end) return false;
+
+		// mag = mag * 10^len + chunk
+		uint64_t pow = 1;
+		for (size_t k = 0; k < len; k++) pow *= 10;
+		uint64_t carry = chunk;
+		for (auto &limb : out.mag) {
+			const u128 cur = (u128)limb * pow + carry;
+			limb = (uint64_t)cur;
+			carry = (uint64_t)(cur >> 64);
+		}
+		if (carry != 0) out.mag.push_back(carry);
+	}
+	trim(out.mag);
+	out.neg = negative && !out.mag.empty();
+	return true;
+}
+
+// Divisors of at least this many limbs are divided by multiplying with their
+// reciprocal, which costs a few products, instead of by long division.
+static constexpr size_t reciprocal_threshold = 64;
+
+// Approximates B^2m / d, where B is the limb base and m the limbs of d, to
+// within a few units. Newton's iteration R' = R + R (B^2m - d R) / B^2m
+// doubles the correct limbs of an estimate made from the top half of d.
+static Limbs reciprocal(const Limbs &d) {
+	const size_t m = d.size();
+	Limbs one(2 * m + 1);
+	one.back() = 1;
+	if (m < reciprocal_threshold) return div_knuth(one, d);
+
+	// two limbs more than half make up for the error of truncating d
+	const size_t h = m / 2 + 2;
+	Limbs r = reciprocal(Limbs(d.end() - (long)h, d.end()));
+	r.insert(r.begin(), m - h, 0);
+
+	const Limbs dr = mul_mag(d, r);
+	if (cmp_mag(dr, one) <= 0) {
+		const Limbs step = shr_mag(mul_mag(r, sub_mag(one, dr)), 128 * m);
+		return add_mag(r, step);
+	}
+	const Limbs step = shr_mag(mul_mag(r, sub_mag(dr, one)), 128 * m);
+	return sub_mag(r, step);
+}
+
+// Numbers of more limbs are split in two to be printed
+static constexpr size_t split_threshold = 32;
+
+// 10^(19 * 2^k), with what dividing by it takes
+struct DecimalPower {
+	Limbs pow;
+	Limbs recip; // for Barrett reduction, if it has enough limbs
+};
+
+// Divides x, which is less than the square of the power, into the quotient it
+// returns and the remainder left in x. The power has at least two limbs.
+static Limbs divmod_power(Limbs &x, const DecimalPower &p) {
+	if (cmp_mag(x, p.pow) < 0) return {};
+
+	// The limbs of x below the top m + 1 barely change the quotient, so they're
+	// left out of the product. It's a few too small or large at most, then
+	// corrected.
+	const size_t m = p.pow.size();
+	Limbs q = p.recip.empty()
+		? div_knuth(x, p.pow)
+		: shr_mag(mul_mag(shr_mag(x, 64 * (m - 1)), p.recip), 64 * (m + 1));
+	Limbs qd = mul_mag(q, p.pow);
+	while (cmp_mag(qd, x) > 0) {
+		q = sub_mag(q, Limbs {1});
+		qd = sub_mag(qd, p.pow);
+	}
+	x = sub_mag(x, qd);
+	while (cmp_mag(x, p.pow) >= 0) {
+		q = add_mag(q, Limbs {1});
+		x = sub_mag(x, p.pow);
+	}
+	return q;
+}
+
+// Appends the digits of x, less than 10^(19 * 2^k), with leading zeros to all
+// 19 * 2^k if pad. Splits it at half as many digits until it's small enough
+// for single limb divisions, which are quadratic.
+static void write_digits(
+	Limbs x, size_t k, bool pad, const std::vector<DecimalPower> &pows, std::string &out
+) {
+	const size_t digits = chunk_digits << k;
+	if (x.size() > split_threshold) {
+		Limbs q = divmod_power(x, pows[k - 1]);
+		if (q.empty() && !pad) {
+			write_digits(std::move(x), k - 1, false, pows, out);
+			return;
+		}
+		write_digits(std::move(q), k - 1, pad, pows, out);
+		write_digits(std::move(x), k - 1, true, pows, out);
+		return;
+	}
+
+	std::vector<uint64_t> chunks;
+	while (!x.empty()) chunks.push_back(divmod_limb(x, chunk_base));
+	const size_t start = out.size();
+	char buf[24];
+	for (size_t i = chunks.size(); i-- > 0;) {
+		auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), chunks[i]);
+		if (i + 1 != chunks.size()) out.append(chunk_digits - (size_t)(end - buf), '0');
+		out.append(buf, end);
+	}
+	if (pad) out.insert(start, digits - (out.size() - start), '0');
+	else if (chunks.empty()) out += '0';
+}
+
+std::string BigInt::to_string() const {
+	if (mag.empty()) return "0";
+	// up to the first power above the magnitude, which isn't divided by
+	std::vector<DecimalPower> pows {{Limbs {chunk_base}, {}}};
+	while (cmp_mag(pows.back().pow, mag) <= 0) {
+		DecimalPower &last = pows.back();
+		if (last.pow.size() >= reciprocal_threshold) last.recip = reciprocal(last.pow);
+		Limbs next = mul_mag(last.pow, last.pow);
+		pows.push_back(DecimalPower {std::move(next), {}});
+	}
+
+	std::string res;
+	res.reserve(mag.size() * 20 + 1);
+	if (neg) res += '-';
+	write_digits(mag, pows.size() - 1, false, pows, res);
+	return res;
+}
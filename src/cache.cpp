@@ -0,0 +1,150 @@
+#include "cache.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+#include "eval.hpp"
+#include "lex.hpp"
+#include "opt.hpp"
+#include "parse.hpp"
+#include "profile.hpp"
+#include "types.hpp"
+#include "vm.hpp"
+
+Value Program::run(bool vm) const {
+	Value val = value_nil();
+	for (auto &form : forms) {
+		val = vm && compiled ? ::run(form.code) : eval(form.tree, text(form));
+		if (val.type == Value::Type::Error) break;
+	}
+	profile_spans("", src);
+	return val;
+}
+
+size_t Program::bytes() const {
+	size_t res = sizeof(Program) + src.capacity();
+	for (auto &form : forms) {
+		res += sizeof(Form) + form.tree.nodes.capacity() * sizeof(CST::Node)
+		     + form.tree.text.capacity()
+		     + form.tree.errors.capacity() * sizeof(SyntaxError)
+		     + form.code.code.capacity() * sizeof(Bytecode::Instr)
+		     + form.code.nums.capacity() * sizeof(int64_t);
+		for (auto &e : form.tree.errors) res += e.msg.capacity();
+		for (auto &s : form.code.strs) res += sizeof(s) + s.capacity();
+		for (auto &l : form.code.lits) res += sizeof(l) + l.size();
+		for (auto &b : form.code.bigs) res += sizeof(b) + b.mag.capacity() * sizeof(uint64_t);
+	}
+	return res;
+}
+
+Program make_program(std::string_view src, bool check, bool fold, bool compile) {
+	Program prog;
+	prog.src = src;
+	prog.compiled = compile;
+	TokenStream tks(prog.src);
+	CST tree;
+	while (parse_form(tks, tree)) {
+		Program::Form form {};
+		form.offset = (size_t)(tks.text().data() - prog.src.data());
+		form.line = tks.line();
+		form.column = tks.column();
+		bool ok = tree.success();
+		if (ok && check) {
+			ok = check_types(tree, tks.text());
+			form.ill_typed = !ok;
+		}
+		if (ok && fold) fold_constants(tree, tks.text());
+		if (ok && compile) form.code = ::compile(tree, tks.text());
+		tree.nodes.shrink_to_fit();
+		form.tree = std::move(tree);
+		prog.forms.push_back(std::move(form));
+		if (!ok) break;
+		tree = CST {};
+	}
+	return prog;
+}
+
+// Multiplicative hash over 8 bytes at a time. Sources are hashed on every
+// lookup, so this trades quality for speed, and lookups compare the text.
+uint64_t hash_source(std::string_view src) {
+	constexpr uint64_t mul = 0x9e3779b97f4a7c15;
+	uint64_t h = src.size() * mul;
+	size_t i = 0;
+	for (; i + 8 <= src.size(); i += 8) {
+		uint64_t word;
+		std::memcpy(&word, src.data() + i, 8);
+		h = (h ^ word) * mul;
+		h ^= h >> 29;
+	}
+	uint64_t tail = 0;
+	if (i < src.size()) std::memcpy(&tail, src.data() + i, src.size() - i);
+	h = (h ^ tail) * mul;
+	return h ^ (h >> 32);
+}
+
+ProgramCache::ProgramCache(Options opts) : opts {opts} {}
+
+std::shared_ptr<const Program> ProgramCache::get(std::string_view src) {
+	const uint64_t hash = hash_source(src);
+	{
+		std::lock_guard lock(mutex);
+		auto [it, end] = index.equal_range(hash);
+		for (; it != end; it++) {
+			if (it->second->prog->src != src) continue;
+			lru.splice(lru.begin(), lru, it->second);
+			counts.hits++;
+			return it->second->prog;
+		}
+		counts.misses++;
+	}
+
+	// parsed without the lock, another thread may be doing the same
+	auto prog = std::make_shared<const Program>(
+		make_program(src, opts.check, opts.fold, opts.compile)
+	);
+	const size_t bytes = prog->bytes();
+
+	std::lock_guard lock(mutex);
+	auto [it, end] = index.equal_range(hash);
+	for (; it != end; it++)
+		if (it->second->prog->src == src) return it->second->prog;
+	lru.push_front(Entry {hash, prog, bytes});
+	index.emplace(hash, lru.begin());
+	counts.entries++;
+	counts.bytes += bytes;
+	evict();
+	return prog;
+}
+
+// drops the least recently used entries, keeping at least the newest one
+void ProgramCache::evict() {
+	while (counts.bytes > opts.max_bytes && lru.size() > 1) {
+		const Entry &last = lru.back();
+		auto [it, end] = index.equal_range(last.hash);
+		for (; it != end; it++)
+			if (it->second == std::prev(lru.end())) {
+				index.erase(it);
+				break;
+			}
+		counts.bytes -= last.bytes;
+		counts.entries--;
+		counts.evictions++;
+		lru.pop_back();
+	}
+}
+
+ProgramCache::Stats ProgramCache::stats() const {
+	std::lock_guard lock(mutex);
+	return counts;
+}
+
+void ProgramCache::clear() {
+	std::lock_guard lock(mutex);
+	index.clear();
+	lru.clear();
+	counts.entries = 0;
+	counts.bytes = 0;
+}
@@ -1,276 +1,713 @@
 #include "eval.hpp"
 
 #include <cerrno>
+#include <charconv>
 #include <cstdint>
-#include <map>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include "arena.hpp"
+#include "bigint.hpp"
+#include "gc.hpp"
 #include "io.hpp"
 #include "parse.hpp"
+#include "pool.hpp"
+#include "profile.hpp"
+#include "rope.hpp"
+#include "symbol.hpp"
 
 using std::string;
 
-Value value_string(std::string &str) {
-	Value val {};
+// where the boxed values made on this thread are allocated, if not the heap
+static thread_local Arena *value_arena = nullptr;
+
+Arena *set_value_arena(Arena *arena) {
+	Arena *prev = value_arena;
+	value_arena = arena;
+	return prev;
+}
+
+// where they are allocated otherwise, if not leaked
+static thread_local Heap *value_heap = nullptr;
+
+Heap *set_value_heap(Heap *heap) {
+	Heap *prev = value_heap;
+	value_heap = heap;
+	return prev;
+}
+
+template<typename T, typename... Args>
+static const T *box(Args &&...args) {
+	if (value_arena != nullptr) return value_arena->make<T>(std::forward<Args>(args)...);
+	if (value_heap != nullptr) return value_heap->make<T>(std::forward<Args>(args)...);
+	return new T(std::forward<Args>(args)...);
+}
+
+void collect_values(std::span<const Value> live) {
+	if (value_heap == nullptr || !value_heap->due()) return;
+	value_heap->collect([live](Heap &heap) {
+		for (auto &val : live) heap.mark(val);
+	});
+}
+
+std::string_view value_text(const Value &str) {
+	const auto res = str.rope->flat();
+	if (value_heap != nullptr) value_heap->remeasure(str.rope);
+	return res;
+}
+
+Value value_string(std::string_view str) { return value_rope(box<Rope>(str)); }
+
+Value value_rope(const Rope *rope) {
+	Value val;
 	val.type = Value::Type::String;
-	val.box = (void *)new string(str);
+	val.rope = rope;
 	return val;
 }
 
-Value value_error(std::string &error_msg) {
+Value value_error(std::string_view error_msg) {
 	Value val;
 	val.type = Value::Type::Error;
-	val.box = (void *)new string(error_msg);
+	val.str = box<string>(error_msg);
 	return val;
 }
 
-Value value_sym(std::string &sym) {
+Value value_big(BigInt &&num) {
+	int64_t small;
+	if (num.to_int(small)) return value_num(small);
+	Value val;
+	val.type = Value::Type::BigNumber;
+	val.big = box<BigInt>(std::move(num));
+	return val;
+}
+
+Value value_number(std::string_view digits) {
+	int64_t num = 0;
+	const auto [p, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), num);
+	if (ec != std::errc::result_out_of_range) return value_num(num);
+	BigInt big;
+	BigInt::parse(digits, big);
+	return value_big(std::move(big));
+}
+
+Value value_sym(SymbolId sym) {
 	Value val;
 	val.type = Value::Type::Symbol;
-	val.box = (void *)new string(sym);
+	val.sym = sym;
 	return val;
 }
 
 Value value_num(int64_t num) {
 	Value val;
 	val.type = Value::Type::Number;
-	val.box = (void *)new int64_t(num);
+	val.num = num;
 	return val;
 }
 
-Value value_nil() { return Value {Value::Type::Nil, nullptr}; }
+Value value_nil() {
+	Value val;
+	val.type = Value::Type::Nil;
+	val.num = 0;
+	return val;
+}
 
-using Evaluator = Value(std::vector<Value> &);
+// Arguments of applications are evaluated onto a stack shared by the whole
+// evaluation, so that applying a builtin does not allocate.
+using Stack = std::vector<Value>;
+
+// What parallel evaluation knows of each node of the tree
+struct Parallel {
+	Pool &pool;
+	std::vector<uint8_t> pure;   // no side effects anywhere in the subtree
+	std::vector<size_t> weight; // nodes in the subtree
+	std::vector<uint8_t> split;  // arguments are evaluated as parallel tasks
+};
+
+Value eval_node(
+	const CST &tree,
+	const CST::Node &node,
+	std::string_view src,
+	Stack &stack,
+	const Parallel *par = nullptr
+);
+
+static bool is_number(const Value &val) {
+	return val.type == Value::Type::Number || val.type == Value::Type::BigNumber;
+}
 
-Value eval_node(const CST::Node *node, const std::string &src);
+static BigInt big_of(const Value &val) {
+	return val.type == Value::Type::Number ? BigInt(val.num) : *val.big;
+}
 
-Value eval_add(std::vector<Value> &args) {
-	int64_t acc = 0;
-	for (auto &arg : args) {
-		if (arg.type != Value::Type::Number) {
-			std::string err = "Type Error: expected Number";
-			return value_error(err);
+// Applies op from left to right over the rest of the arguments, starting from
+// init. Stays on int64_t while small reports no overflow, and goes on with
+// bigints from the first operation that does.
+template<typename Small, typename Big>
+static Value fold_numbers(Value init, std::span<Value> rest, Small small, Big big) {
+	size_t i = 0;
+	if (init.type == Value::Type::Number) {
+		int64_t acc = init.num;
+		for (; i < rest.size(); i++) {
+			int64_t next;
+			if (rest[i].type != Value::Type::Number || small(acc, rest[i].num, &next))
+				break;
+			acc = next;
 		}
-		acc += *(int64_t *)arg.box;
+		if (i == rest.size()) return value_num(acc);
+		init = value_num(acc);
 	}
-	return value_num(acc);
+	BigInt acc = big_of(init);
+	for (; i < rest.size(); i++) acc = big(acc, big_of(rest[i]));
+	return value_big(std::move(acc));
 }
 
-Value eval_sub(std::vector<Value> &args) {
-	int64_t acc = 0;
+static bool check_numbers(std::span<Value> args, Value &err) {
 	for (auto &arg : args)
-		if (arg.type != Value::Type::Number) {
-			std::string err = "Type Error: expected Number";
-			return value_error(err);
+		if (!is_number(arg)) {
+			std::string msg = "Type Error: expected Number";
+			err = value_error(msg);
+			return false;
 		}
-	if (args.size() == 1) {
-		acc = -*(int64_t *)args[0].box;
-	} else {
-		acc = *(int64_t *)args[0].box;
-		for (size_t i = 1; i < args.size(); i++) {
-			acc -= *(int64_t *)args[0].box;
-		}
-	}
-	return value_num(acc);
+	return true;
 }
 
-Value eval_mul(std::vector<Value> &args) {
-	int64_t acc = 1;
-	for (auto &arg : args) {
-		if (arg.type != Value::Type::Number) {
-			std::string err = "Type Error: expected Number";
-			return value_error(err);
-		}
-		acc *= *(int64_t *)arg.box;
-	}
+// The typed_ builtins are applied to arguments that check_types proved to
+// have the right types, and only check what types can't tell.
 
-	return value_num(acc);
+static Value typed_add(std::span<Value> args) {
+	return fold_numbers(
+		value_num(0),
+		args,
+		[](int64_t a, int64_t b, int64_t *res) { return __builtin_add_overflow(a, b, res); },
+		[](const BigInt &a, const BigInt &b) { return a + b; }
+	);
 }
 
-Value eval_div(std::vector<Value> &args) {
-	int64_t acc = 1;
-	for (auto &arg : args) {
-		if (arg.type != Value::Type::Number) {
-			std::string err = "Type Error: expected Number";
+Value eval_add(std::span<Value> args) {
+	Value err;
+	if (!check_numbers(args, err)) return err;
+	return typed_add(args);
+}
+
+// negates a single argument, or subtracts the rest from the first
+static Value typed_sub(std::span<Value> args) {
+	if (args.size() == 0) return value_num(0);
+	const bool negate = args.size() == 1;
+	return fold_numbers(
+		negate ? value_num(0) : args[0],
+		negate ? args : args.subspan(1),
+		[](int64_t a, int64_t b, int64_t *res) { return __builtin_sub_overflow(a, b, res); },
+		[](const BigInt &a, const BigInt &b) { return a - b; }
+	);
+}
+
+Value eval_sub(std::span<Value> args) {
+	Value err;
+	if (!check_numbers(args, err)) return err;
+	return typed_sub(args);
+}
+
+static Value typed_mul(std::span<Value> args) {
+	return fold_numbers(
+		value_num(1),
+		args,
+		[](int64_t a, int64_t b, int64_t *res) { return __builtin_mul_overflow(a, b, res); },
+		[](const BigInt &a, const BigInt &b) { return a * b; }
+	);
+}
+
+Value eval_mul(std::span<Value> args) {
+	Value err;
+	if (!check_numbers(args, err)) return err;
+	return typed_mul(args);
+}
+
+// inverts a single argument, or divides the first by the rest, truncating
+static Value typed_div(std::span<Value> args) {
+	if (args.size() == 0) return value_num(1);
+	const bool invert = args.size() == 1;
+	const auto divisors = invert ? args : args.subspan(1);
+	for (auto &arg : divisors)
+		if (arg.type == Value::Type::Number && arg.num == 0) {
+			std::string err = "Division by zero";
 			return value_error(err);
 		}
-		acc /= *(int64_t *)arg.box;
-	}
+	return fold_numbers(
+		invert ? value_num(1) : args[0],
+		divisors,
+		[](int64_t a, int64_t b, int64_t *res) {
+			// the only quotient that does not fit
+			if (a == INT64_MIN && b == -1) return true;
+			*res = a / b;
+			return false;
+		},
+		[](const BigInt &a, const BigInt &b) { return a / b; }
+	);
+}
 
-	return value_num(acc);
+Value eval_div(std::span<Value> args) {
+	Value err;
+	if (!check_numbers(args, err)) return err;
+	return typed_div(args);
+}
+
+static Value typed_print(std::span<Value> args) {
+	print_rope(*args[0].rope);
+	return value_nil();
 }
 
-Value eval_print(std::vector<Value> &args) {
-	if (args[0].type != Value::Type::String) {
+Value eval_print(std::span<Value> args) {
+	if (args.size() == 0 || args[0].type != Value::Type::String) {
 		std::string err = "Type Error: expected String";
 		return value_error(err);
 	}
+	return typed_print(args);
+}
 
-	print_str(*(string *)args[0].box);
-	return value_nil();
+static Value typed_not(std::span<Value> args) {
+	// bigints are never zero
+	return value_num(args[0].type == Value::Type::Number && !args[0].num);
 }
 
-Value eval_not(std::vector<Value> &args) {
+Value eval_not(std::span<Value> args) {
 	if (args.size() != 1) {
 		std::string err = "Type Error: wrong number of arguments";
 		return value_error(err);
 	}
-	if (args[0].type != Value::Type::Number) {
+	if (!is_number(args[0])) {
 		std::string err = "Type Error: expected Number";
 		return value_error(err);
 	}
+	return typed_not(args);
+}
 
-	return value_num(!*(int64_t *)(args[0].box));
+static Value typed_println(std::span<Value> args) {
+	print_rope(*args[0].rope);
+	print_str("\n");
+	return args[0];
 }
 
-Value eval_println(std::vector<Value> &args) {
-	if (args[0].type != Value::Type::String) {
+Value eval_println(std::span<Value> args) {
+	if (args.size() == 0 || args[0].type != Value::Type::String) {
 		std::string err = "Type Error: expected String";
 		return value_error(err);
 	}
+	return typed_println(args);
+}
 
-	print_str(*(string *)args[0].box);
-	printf("\n");
-	return args[0];
+// bitwise operations only take numbers that fit 64 bits
+static Value bitwise_error(const Value &arg) {
+	std::string err = arg.type == Value::Type::BigNumber
+	                  ? "Type Error: expected a 64-bit Number"
+	                  : "Type Error: expected Number";
+	return value_error(err);
 }
 
-Value eval_and(std::vector<Value> &args) {
+Value eval_and(std::span<Value> args) {
 	int64_t acc = 1;
 	for (auto &arg : args) {
-		if (arg.type != Value::Type::Number) {
-			std::string err = "Type Error: expected Number";
-			return value_error(err);
-		}
-		acc = acc & *(int64_t *)arg.box;
+		if (arg.type != Value::Type::Number) return bitwise_error(arg);
+		acc = acc & arg.num;
 	}
 	return value_num(acc);
 }
 
-Value eval_or(std::vector<Value> &args) {
+Value eval_or(std::span<Value> args) {
 	int64_t acc = 1;
 	for (auto &arg : args) {
-		if (arg.type != Value::Type::Number) {
-			std::string err = "Type Error: expected Number";
-			return value_error(err);
-		}
-		acc = acc | *(int64_t *)arg.box;
+		if (arg.type != Value::Type::Number) return bitwise_error(arg);
+		acc = acc | arg.num;
 	}
 	return value_num(acc);
 }
 
-Value eval_xor(std::vector<Value> &args) {
+Value eval_xor(std::span<Value> args) {
 	int64_t acc = 1;
 	for (auto &arg : args) {
-		if (arg.type != Value::Type::Number) {
-			std::string err = "Type Error: expected Number";
-			return value_error(err);
-		}
-		acc = acc ^ *(int64_t *)arg.box;
+		if (arg.type != Value::Type::Number) return bitwise_error(arg);
+		acc = acc ^ arg.num;
 	}
 	return value_num(acc);
 }
 
-Value eval_concat(std::vector<Value> &args) {
-	std::string acc {""};
-	for (auto &arg : args) {
-		// leaks memory if there's a type error
+// links the arguments into a rope without copying them
+static Value typed_concat(std::span<Value> args) {
+	if (args.size() == 0) return value_string("");
+	const Rope *acc = args[0].rope;
+	for (size_t i = 1; i < args.size(); i++) acc = box<Rope>(acc, args[i].rope);
+	return value_rope(acc);
+}
+
+Value eval_concat(std::span<Value> args) {
+	for (auto &arg : args)
 		if (arg.type != Value::Type::String) {
 			std::string err = "Type Error: expected String";
 			return value_error(err);
 		}
-		acc += *(string *)arg.box;
+	return typed_concat(args);
+}
+
+// Shifts past this many bits are refused instead of allocating the result
+static constexpr int64_t max_shift = 1 << 24;
+
+// checks the amount of a shift of numbers
+static bool check_amount(std::span<Value> args, Value &err) {
+	if (args[1].type != Value::Type::Number || args[1].num < 0
+	    || args[1].num > max_shift) {
+		std::string msg = "Shift amount out of range";
+		err = value_error(msg);
+		return false;
 	}
-	return value_string(acc);
+	return true;
 }
 
-Value eval_lsh(std::vector<Value> &args) {
+// checks the operands of a shift
+static bool check_shift(std::span<Value> args, Value &err) {
 	if (args.size() != 2) {
-		std::string err = "Type Error: wrong number of arguments";
-		return value_error(err);
-	}
-	if (args[0].type != Value::Type::Number || args[1].type != Value::Type::Number) {
-		std::string err = "Type Error: expected Number";
-		return value_error(err);
+		std::string msg = "Type Error: wrong number of arguments";
+		err = value_error(msg);
+		return false;
 	}
+	return check_numbers(args, err) && check_amount(args, err);
+}
 
-	return value_num(*(int64_t *)args[0].box << *(int64_t *)args[1].box);
+static Value typed_lsh(std::span<Value> args) {
+	Value err;
+	if (!check_amount(args, err)) return err;
+	const int64_t x = args[0].num, n = args[1].num;
+	if (args[0].type == Value::Type::Number && n < 64 && ((x << n) >> n) == x)
+		return value_num(x << n);
+	return value_big(big_of(args[0]) << (size_t)n);
 }
 
-Value eval_rsh(std::vector<Value> &args) {
-	if (args.size() != 2) {
-		std::string err = "Type Error: wrong number of arguments";
-		return value_error(err);
+Value eval_lsh(std::span<Value> args) {
+	Value err;
+	if (!check_shift(args, err)) return err;
+	return typed_lsh(args);
+}
+
+static Value typed_rsh(std::span<Value> args) {
+	Value err;
+	if (!check_amount(args, err)) return err;
+	const int64_t x = args[0].num, n = args[1].num;
+	if (args[0].type == Value::Type::Number) return value_num(n < 64 ? x >> n : x >> 63);
+	return value_big(*args[0].big >> (size_t)n);
+}
+
+Value eval_rsh(std::span<Value> args) {
+	Value err;
+	if (!check_shift(args, err)) return err;
+	return typed_rsh(args);
+}
+
+Evaluator *const builtins[builtin_count] = {
+	eval_add,
+	eval_sub,
+	eval_mul,
+	eval_div,
+	eval_lsh,
+	eval_rsh,
+	eval_concat,
+	eval_print,
+	eval_and,
+	eval_or,
+	eval_xor,
+	eval_not,
+	eval_println,
+};
+
+// the bitwise operations still have to tell 64-bit numbers from big ones
+Evaluator *const typed_builtins[builtin_count] = {
+	typed_add,
+	typed_sub,
+	typed_mul,
+	typed_div,
+	typed_lsh,
+	typed_rsh,
+	typed_concat,
+	typed_print,
+	eval_and,
+	eval_or,
+	eval_xor,
+	typed_not,
+	typed_println,
+};
+
+// subtrees smaller than this are not worth a task
+static constexpr size_t min_task_weight = 1024;
+
+static bool has_effects(SymbolId sym) {
+	return sym == (SymbolId)Builtin::Put || sym == (SymbolId)Builtin::Println;
+}
+
+struct ArgTask {
+	const CST *tree;
+	const CST::Node *node;
+	std::string_view src;
+	const Parallel *par;
+	// Where the task makes its values, which the heap of the thread that
+	// spawned it adopts once joined. None if that thread has none either.
+	std::unique_ptr<Heap> heap;
+	Value res;
+
+	static void run(void *arg) {
+		auto task = (ArgTask *)arg;
+		thread_local Stack stack;
+		Heap *prev = set_value_heap(task->heap.get());
+		task->res =
+			eval_node(*task->tree, *task->node, task->src, stack, task->par);
+		set_value_heap(prev);
 	}
-	if (args[0].type != Value::Type::Number || args[1].type != Value::Type::Number) {
-		std::string err = "Type Error: expected Number";
-		return value_error(err);
+};
+
+// Evaluates the arguments of a pure application concurrently, pushing them in
+// order. Returns the first error among them, like evaluating them in order
+// would, since none has side effects.
+static bool eval_args_parallel(
+	const CST &tree,
+	std::span<const CST::Node> args,
+	std::string_view src,
+	Stack &stack,
+	const Parallel &par,
+	Value &err
+) {
+	std::vector<ArgTask> tasks(args.size());
+	Pool::Group group;
+	const auto heavy = [&](size_t i) {
+		return par.weight[(size_t)(&args[i] - tree.nodes.data())] >= min_task_weight;
+	};
+	// the last heavy argument is kept for this thread
+	size_t last = 0;
+	for (size_t i = 0; i < args.size(); i++)
+		if (heavy(i)) last = i;
+	const auto spawned = [&](size_t i) { return i != last && heavy(i); };
+	for (size_t i = 0; i < args.size(); i++) {
+		if (!spawned(i)) continue;
+		tasks[i] = ArgTask {&tree, &args[i], src, &par, nullptr, value_nil()};
+		if (value_heap != nullptr)
+			tasks[i].heap = std::make_unique<Heap>(value_heap->options());
+		par.pool.spawn(group, ArgTask::run, &tasks[i]);
+	}
+
+	// The values of this thread are kept in their places on the stack, where
+	// collections see them, and those of the tasks put there once joined.
+	const size_t base = stack.size();
+	stack.resize(base + args.size(), value_nil());
+	for (size_t i = 0; i < args.size(); i++) {
+		if (spawned(i)) continue;
+		const Value val = eval_node(tree, args[i], src, stack, &par);
+		stack[base + i] = val;
+	}
+	par.pool.wait(group);
+	for (size_t i = 0; i < args.size(); i++) {
+		if (!spawned(i)) continue;
+		if (tasks[i].heap) value_heap->adopt(*tasks[i].heap);
+		stack[base + i] = tasks[i].res;
 	}
+	// with what the tasks left behind, the heap may be due
+	collect_values(stack);
 
-	return value_num(*(int64_t *)args[0].box >> *(int64_t *)args[1].box);
+	for (size_t i = base; i < stack.size(); i++) {
+		if (stack[i].type == Value::Type::Error) {
+			err = stack[i];
+			return false;
+		}
+	}
+	return true;
 }
 
-Value eval_app(const CST::Node *node, const std::string &src) {
-	CST::Node *func_node = node->children[0];
-	std::string func = src.substr(func_node->beg, func_node->len);
-	std::vector<Value> args;
+// An application whose arguments are being evaluated. Evaluation keeps these
+// on the heap instead of recursing, so the depth of a tree is only bounded by
+// memory and not by the native stack.
+struct Frame {
+	const CST::Node *app;
+	size_t base;   // where its arguments start on the stack
+	uint32_t next; // child being evaluated
+};
+
+static Value apply(
+	const CST &tree, const CST::Node &app, std::string_view src, Stack &stack, size_t base
+) {
+	const SymbolId func = tree.nodes[app.first].sym;
+	Evaluator *const *table = app.typed ? typed_builtins : builtins;
+	const auto args = std::span(stack).subspan(base);
+	Value res;
+	if (profiling()) [[unlikely]] {
+		const auto start = ProfileClock::now();
+		res = table[func](args);
+		profile_apply(func, src.data() + app.beg, app.len, profile_ns_since(start));
+	} else {
+		res = table[func](args);
+	}
+	stack.resize(base);
+	return res;
+}
 
-	for (size_t i = 1; i < node->children.size(); i++) {
-		Value val = eval_node(node->children[i], src);
-		if (val.type == Value::Type::Error) return value_error(*(string *)val.box);
-		args.push_back(val);
+// Starts evaluating an application. Returns its first argument after pushing a
+// frame for it, or nullptr when the application already has its value in res.
+static const CST::Node *eval_app(
+	const CST &tree,
+	const CST::Node &node,
+	std::string_view src,
+	Stack &stack,
+	const Parallel *par,
+	std::vector<Frame> &frames,
+	Value &res
+) {
+	const auto children = tree.children(node);
+	if (children.size() == 0) {
+		std::string err = "Empty application";
+		res = value_error(err);
+		return nullptr;
 	}
 
-	std::map<std::string, Evaluator *> funcs;
-	funcs["add"] = eval_add;
-	funcs["sub"] = eval_sub;
-	funcs["mul"] = eval_mul;
-	funcs["div"] = eval_div;
-	funcs["shl"] = eval_lsh;
-	funcs["shr"] = eval_rsh;
-	funcs["cat"] = eval_concat;
-	funcs["put"] = eval_print;
-	funcs["and"] = eval_and;
-	funcs["or"] = eval_or;
-	funcs["xor"] = eval_xor;
-	funcs["not"] = eval_not;
-	funcs["println"] = eval_println;
-
-	Evaluator *e = funcs[func];
-	if (e != nullptr)
-		return e(args);
-	else {
-		std::string err = "Unknown function \"" + func + "\"";
-		return value_error(err);
+	const CST::Node &func_node = children[0];
+	if (func_node.type != CST::Type::Symbol || !is_builtin(func_node.sym)) {
+		std::string err = "Unknown function \"";
+		err += src.substr(func_node.beg, func_node.len);
+		err += "\"";
+		res = value_error(err);
+		return nullptr;
 	}
-}
 
-// can also be called replace_node or reduce_node
-Value eval_node(const CST::Node *node, const std::string &src) {
-	switch (node->type) {
-		case CST::Type::App: return eval_app(node, src);
-		case CST::Type::Number: {
-			std::string num_repr = src.substr(node->beg, node->len);
-			int64_t num = std::stol(num_repr, nullptr);
-			return value_num(num);
-			break;
-		}
-		case CST::Type::Symbol: {
-			std::string sym_repr = src.substr(node->beg, node->len);
-			return value_sym(sym_repr);
-			break;
+	const size_t base = stack.size();
+	const auto index = (size_t)(&node - tree.nodes.data());
+	if (par != nullptr && par->split[index]) {
+		if (!eval_args_parallel(tree, children.subspan(1), src, stack, *par, res)) {
+			stack.resize(base);
+			return nullptr;
 		}
+		res = apply(tree, node, src, stack, base);
+		return nullptr;
+	}
+
+	if (children.size() == 1) {
+		res = apply(tree, node, src, stack, base);
+		return nullptr;
+	}
+	frames.push_back(Frame {&node, base, 1});
+	return &children[1];
+}
+
+static Value eval_leaf(const CST &tree, const CST::Node &node, std::string_view src) {
+	switch (node.type) {
+		case CST::Type::Number: return value_number(tree.text_of(node, src));
+		case CST::Type::Symbol: return value_sym(node.sym);
 		case CST::Type::String: {
-			std::string str_repr =
-				src.substr(node->beg, node->len); // skip double quotes
-			return value_string(str_repr);
+			return value_string(tree.text_of(node, src));
 		}
+		case CST::Type::App: break;
 	}
 	std::string err = "Unknown syntax tree node type";
 	return value_error(err);
 }
 
-Value eval(const CST &tree, const std::string &src) {
-	return eval_node(tree.root, src);
+// can also be called replace_node or reduce_node
+Value eval_node(
+	const CST &tree,
+	const CST::Node &node,
+	std::string_view src,
+	Stack &stack,
+	const Parallel *par
+) {
+	// shared by the nested evaluations of parallel tasks run on this thread,
+	// which only ever use the frames above the ones they found
+	thread_local std::vector<Frame> frames;
+	const size_t floor = frames.size();
+
+	const CST::Node *next = &node;
+	Value val;
+	while (true) {
+		// descend into first arguments until something has a value
+		while (next != nullptr) {
+			if (next->type == CST::Type::App)
+				next = eval_app(tree, *next, src, stack, par, frames, val);
+			else {
+				val = eval_leaf(tree, *next, src);
+				next = nullptr;
+			}
+		}
+
+		// and hand it to the application waiting for it
+		if (frames.size() == floor) return val;
+		Frame &frame = frames.back();
+		if (val.type == Value::Type::Error) {
+			stack.resize(frame.base);
+			frames.pop_back();
+			continue;
+		}
+		stack.push_back(val);
+		if (++frame.next < frame.app->count) {
+			next = &tree.nodes[frame.app->first + frame.next];
+			continue;
+		}
+		val = apply(tree, *frame.app, src, stack, frame.base);
+		frames.pop_back();
+
+		if (value_heap != nullptr && value_heap->due()) {
+			stack.push_back(val);
+			collect_values(stack);
+			stack.pop_back();
+		}
+	}
+}
+
+Value eval(const CST &tree, std::string_view src) {
+	ProfileScope scope(Phase::Eval);
+	// Reused between evaluations to keep them allocation free. One may start on
+	// a thread waiting for tasks in the middle of another, so each only uses
+	// the part of the stack above what it found.
+	thread_local Stack stack;
+	const size_t base = stack.size();
+	const Value res = eval_node(tree, tree.root_node(), src, stack);
+	stack.resize(base);
+	return res;
+}
+
+Value eval(const CST &tree, std::string_view src, Pool &pool) {
+	if (pool.threads() == 1) return eval(tree, src);
+	ProfileScope scope(Phase::Eval);
+
+	// children come before their parents, so one pass sees all of them
+	const size_t n = tree.nodes.size();
+	Parallel par {
+		pool, std::vector<uint8_t>(n), std::vector<size_t>(n), std::vector<uint8_t>(n)
+	};
+	for (size_t i = 0; i < tree.nodes.size(); i++) {
+		const auto &node = tree.nodes[i];
+		bool pure = true;
+		size_t weight = 1;
+		if (node.type == CST::Type::App) {
+			for (size_t c = node.first; c < node.first + node.count; c++) {
+				pure = pure && par.pure[c];
+				weight += par.weight[c];
+			}
+			const auto &head = tree.nodes[node.first];
+			if (node.count != 0 && head.type == CST::Type::Symbol
+			    && has_effects(head.sym))
+				pure = false;
+		}
+		par.pure[i] = pure;
+		par.weight[i] = weight;
+
+		// only applications with two or more heavy arguments are split, so the
+		// native stack of nested splits grows with the log of the tree size
+		size_t heavy = 0;
+		if (node.type == CST::Type::App)
+			for (size_t c = node.first + 1; c < node.first + node.count; c++)
+				if (par.weight[c] >= min_task_weight) heavy++;
+		par.split[i] = pure && heavy >= 2;
+	}
+
+	// a stack of its own, which nested evaluations on this thread share in the
+	// same way as the sequential one above
+	thread_local Stack stack;
+	const size_t base = stack.size();
+	const Value res = eval_node(tree, tree.root_node(), src, stack, &par);
+	stack.resize(base);
+	return res;
 }
@@ -0,0 +1,183 @@
+#include "gc.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <string>
+
+#include "bigint.hpp"
+#include "eval.hpp"
+#include "rope.hpp"
+
+size_t gc_extra(const Rope &rope) { return rope.links().first ? 0 : rope.size(); }
+size_t gc_extra(const std::string &str) { return str.capacity(); }
+size_t gc_extra(const BigInt &big) { return big.mag.capacity() * sizeof(uint64_t); }
+
+Heap::Heap(Options opts) : opts {opts}, limit {opts.threshold} {}
+
+Heap::~Heap() {
+	for (Object *o = young; o != nullptr; o = o->next) o->destroy(o + 1);
+	for (Object *o = old; o != nullptr; o = o->next) o->destroy(o + 1);
+	for (auto page : pages)
+		::operator delete((void *)page, std::align_val_t(page_size));
+}
+
+void *Heap::allocate(size_t cls) {
+	Page *page = partial[cls];
+	if (page == nullptr) {
+		page = new (::operator new(page_size, std::align_val_t(page_size))) Page;
+		*page = Page {nullptr, nullptr, (char *)(page + 1), 0, cls};
+		partial[cls] = page;
+		const auto addr = (uintptr_t)page;
+		pages.insert(std::upper_bound(pages.begin(), pages.end(), addr), addr);
+	}
+
+	void *res;
+	if (page->free != nullptr) {
+		res = page->free;
+		page->free = page->free->next;
+	} else {
+		res = page->cur;
+		page->cur += (cls + 1) * slot_align;
+	}
+	page->live++;
+	if (page->full()) partial[cls] = page->next;
+	return res;
+}
+
+void Heap::adopt(Heap &other) {
+	// Splices both lists of the other in front of our young one. Its old
+	// objects are younger than ours, which must not see them as old.
+	for (Object **list : {&other.young, &other.old}) {
+		if (*list == nullptr) continue;
+		Object *last = *list;
+		last->old = false;
+		while (last->next != nullptr) {
+			last = last->next;
+			last->old = false;
+		}
+		last->next = young;
+		young = *list;
+		*list = nullptr;
+	}
+	young_bytes += other.st.bytes;
+	for (size_t i = 0; i < class_count; i++) {
+		while (Page *page = other.partial[i]) {
+			other.partial[i] = page->next;
+			page->next = partial[i];
+			partial[i] = page;
+		}
+	}
+	const auto &more = other.pages;
+	const auto mid = pages.insert(pages.end(), more.begin(), more.end());
+	std::inplace_merge(pages.begin(), mid, pages.end());
+	pinned.insert(pinned.end(), other.pinned.begin(), other.pinned.end());
+
+	st.collections += other.st.collections;
+	st.minor_collections += other.st.minor_collections;
+	st.objects += other.st.objects;
+	st.bytes += other.st.bytes;
+	st.allocated += other.st.allocated;
+	st.collected += other.st.collected;
+	st.objects_collected += other.st.objects_collected;
+	st.pause_ns += other.st.pause_ns;
+	st.max_pause_ns = std::max(st.max_pause_ns, other.st.max_pause_ns);
+
+	other.young_bytes = 0;
+	other.pages.clear();
+	other.pinned.clear();
+	other.st = Stats {};
+	other.limit = other.opts.threshold;
+}
+
+void Heap::mark(const Value &val) {
+	switch (val.type) {
+		case Value::Type::String: mark(val.rope); break;
+		case Value::Type::Error: mark(val.str); break;
+		case Value::Type::BigNumber: mark(val.big); break;
+		default: break;
+	}
+}
+
+void Heap::trace_rope(const Rope &rope) {
+	const auto [left, right] = rope.links();
+	mark(left);
+	mark(right);
+}
+
+void Heap::begin() {
+	started = std::chrono::steady_clock::now();
+	full = opts.nursery == 0 || st.bytes >= limit;
+	for (auto &val : pinned) mark(val);
+}
+
+void Heap::finish() {
+	// tracing has a stack of its own, as ropes may be nested very deep
+	while (!gray.empty()) {
+		Object *o = gray.back();
+		gray.pop_back();
+		o->trace(*this, o + 1);
+	}
+
+	sweep(&young);
+	if (full) sweep(&old);
+	// the survivors are old now, in front of the others
+	if (young != nullptr) {
+		Object *last = young;
+		last->old = true;
+		while (last->next != nullptr) {
+			last = last->next;
+			last->old = true;
+		}
+		last->next = old;
+		old = young;
+		young = nullptr;
+	}
+	young_bytes = 0;
+
+	// releases the pages left empty, and lists again those with free slots
+	for (auto &p : partial) p = nullptr;
+	std::erase_if(pages, [this](uintptr_t addr) {
+		Page *page = (Page *)addr;
+		if (page->live == 0) {
+			::operator delete(page, std::align_val_t(page_size));
+			return true;
+		}
+		if (!page->full()) {
+			page->next = partial[page->cls];
+			partial[page->cls] = page;
+		}
+		return false;
+	});
+
+	if (full) limit = std::max(opts.threshold, (size_t)((double)st.bytes * opts.growth));
+	const auto pause = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - started
+	).count();
+	st.collections++;
+	if (!full) st.minor_collections++;
+	st.pause_ns += pause;
+	st.max_pause_ns = std::max(st.max_pause_ns, pause);
+}
+
+// frees the objects of the list left unmarked, and unmarks the others
+void Heap::sweep(Object **list) {
+	Object **link = list;
+	while (Object *o = *link) {
+		if (o->marked) {
+			o->marked = false;
+			link = &o->next;
+			continue;
+		}
+		*link = o->next;
+		st.objects--;
+		st.bytes -= o->size;
+		st.collected += o->size;
+		st.objects_collected++;
+		o->destroy(o + 1);
+		Page *page = page_of(o);
+		o->next = page->free;
+		page->free = o;
+		page->live--;
+	}
+}
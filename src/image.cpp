@@ -0,0 +1,266 @@
+#include "image.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "cache.hpp"
+#include "io.hpp"
+#include "parse.hpp"
+#include "symbol.hpp"
+#include "types.hpp"
+
+namespace {
+
+constexpr char image_magic[4] = {'A', 'L', 'C', '\0'};
+
+struct Header {
+	char magic[4];
+	uint32_t version;
+	uint32_t node_size;
+	uint32_t flags;
+	uint64_t src_size;
+	int64_t src_mtime_ns;
+	uint32_t form_count;
+	uint32_t symbol_count;
+	uint64_t symbols_off; // symbol_count SymbolEntry, then their names
+	uint64_t forms_off;   // form_count FormEntry
+	uint64_t src_off;
+};
+
+struct SymbolEntry {
+	uint32_t off; // from the end of the entries
+	uint32_t len;
+};
+
+struct FormEntry {
+	uint64_t offset; // of the text of the form in the source
+	uint64_t line;
+	uint64_t column;
+	uint32_t root;
+	uint32_t node_count;
+	uint64_t nodes_off;
+	uint64_t text_off;
+	uint64_t text_len;
+};
+
+// appends raw bytes, padded so the next array is aligned
+struct Writer {
+	std::string out;
+
+	template<typename T>
+	uint64_t put(const T *data, size_t count) {
+		out.resize((out.size() + 7) & ~size_t(7));
+		const uint64_t off = out.size();
+		out.append((const char *)data, count * sizeof(T));
+		return off;
+	}
+
+	template<typename T>
+	void patch(uint64_t off, const T &val) {
+		std::memcpy(out.data() + off, &val, sizeof(T));
+	}
+};
+
+// bounds checked view of the mapping
+struct Reader {
+	std::string_view in;
+
+	template<typename T>
+	bool get(uint64_t off, size_t count, const T *&out) const {
+		if (off > in.size() || count > (in.size() - off) / sizeof(T)) return false;
+		if (off % alignof(T) != 0) return false;
+		out = (const T *)(in.data() + off);
+		return true;
+	}
+};
+
+// Whether a flag read from a file is a bool, as using any other byte as one
+// is undefined
+bool valid_flag(const bool &flag) {
+	unsigned char byte;
+	std::memcpy(&byte, &flag, 1);
+	return byte <= 1;
+}
+
+} // namespace
+
+bool source_stamp(const std::filesystem::path &path, SourceStamp &out) {
+	struct stat st {};
+	if (stat(path.c_str(), &st) != 0) return false;
+	out.size = (uint64_t)st.st_size;
+	out.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1'000'000'000 + st.st_mtim.tv_nsec;
+	return true;
+}
+
+std::filesystem::path image_path(const std::filesystem::path &source) {
+	auto res = source;
+	res.replace_extension(".alc");
+	return res;
+}
+
+bool save_image(
+	const std::filesystem::path &path,
+	std::string_view src,
+	const std::vector<Program::Form> &forms,
+	const SourceStamp &stamp,
+	uint32_t flags
+) {
+	// image numbers of the symbols, builtins keep theirs
+	std::vector<SymbolId> ids;
+	std::vector<SymbolId> names; // by image number, past the builtins
+	std::vector<std::vector<CST::Node>> nodes(forms.size());
+	for (size_t f = 0; f < forms.size(); f++) {
+		nodes[f] = forms[f].tree.nodes;
+		for (auto &node : nodes[f]) {
+			if (node.type != CST::Type::Symbol || is_builtin(node.sym)) continue;
+			if (node.sym >= ids.size()) ids.resize(node.sym + 1, 0);
+			if (ids[node.sym] == 0) {
+				ids[node.sym] = builtin_count + (SymbolId)names.size();
+				names.push_back(node.sym);
+			}
+			node.sym = ids[node.sym];
+		}
+	}
+
+	Writer w;
+	Header h {};
+	std::memcpy(h.magic, image_magic, sizeof(image_magic));
+	h.version = image_version;
+	h.node_size = sizeof(CST::Node);
+	h.flags = flags;
+	h.src_size = stamp.size;
+	h.src_mtime_ns = stamp.mtime_ns;
+	h.form_count = (uint32_t)forms.size();
+	h.symbol_count = (uint32_t)names.size();
+	w.put(&h, 1);
+
+	std::vector<SymbolEntry> syms;
+	std::string blob;
+	for (auto sym : names) {
+		const auto name = symbol_name(sym);
+		syms.push_back(SymbolEntry {(uint32_t)blob.size(), (uint32_t)name.size()});
+		blob += name;
+	}
+	h.symbols_off = w.put(syms.data(), syms.size());
+	w.put(blob.data(), blob.size());
+
+	std::vector<FormEntry> entries(forms.size());
+	h.forms_off = w.put(entries.data(), entries.size());
+	for (size_t f = 0; f < forms.size(); f++) {
+		const auto &form = forms[f];
+		auto &e = entries[f];
+		e.offset = form.offset;
+		e.line = form.line;
+		e.column = form.column;
+		e.root = form.tree.root;
+		e.node_count = (uint32_t)nodes[f].size();
+		e.nodes_off = w.put(nodes[f].data(), nodes[f].size());
+		e.text_off = w.put(form.tree.text.data(), form.tree.text.size());
+		e.text_len = form.tree.text.size();
+	}
+	for (size_t f = 0; f < forms.size(); f++)
+		w.patch(h.forms_off + f * sizeof(FormEntry), entries[f]);
+	h.src_off = w.put(src.data(), src.size());
+	w.patch(0, h);
+
+	// unique per thread, as a batch may run the same file twice at once
+	auto tmp = path;
+	tmp += ".tmp" + std::to_string(getpid()) + "."
+	     + std::to_string(std::hash<std::thread::id> {}(std::this_thread::get_id()));
+	{
+		std::ofstream f(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!f.write(w.out.data(), (std::streamsize)w.out.size())) {
+			f.close();
+			std::filesystem::remove(tmp);
+			return false;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(tmp, path, ec);
+	if (ec) std::filesystem::remove(tmp, ec);
+	return !ec;
+}
+
+bool Image::load(const SourceStamp &stamp, uint32_t flags) {
+	const Reader r {file.text()};
+	const Header *h;
+	if (!r.get(0, 1, h)) return false;
+	if (std::memcmp(h->magic, image_magic, sizeof(image_magic)) != 0
+	    || h->version != image_version || h->node_size != sizeof(CST::Node)
+	    || h->flags != flags || h->src_size != stamp.size
+	    || h->src_mtime_ns != stamp.mtime_ns)
+		return false;
+
+	const char *text;
+	if (!r.get(h->src_off, h->src_size, text)) return false;
+	src = std::string_view(text, h->src_size);
+
+	// the process may have interned other symbols before these
+	const SymbolEntry *syms;
+	const char *names;
+	const uint64_t names_off = h->symbols_off + h->symbol_count * sizeof(SymbolEntry);
+	if (!r.get(h->symbols_off, h->symbol_count, syms)) return false;
+	std::vector<SymbolId> ids(h->symbol_count);
+	bool renumber = false;
+	for (uint32_t i = 0; i < h->symbol_count; i++) {
+		if (!r.get(names_off + syms[i].off, syms[i].len, names)) return false;
+		ids[i] = intern(std::string_view(names, syms[i].len));
+		renumber |= ids[i] != builtin_count + i;
+	}
+
+	const FormEntry *entries;
+	if (!r.get(h->forms_off, h->form_count, entries)) return false;
+	forms.resize(h->form_count);
+	for (uint32_t f = 0; f < h->form_count; f++) {
+		const FormEntry &e = entries[f];
+		const CST::Node *nodes;
+		const char *form_text;
+		if (!r.get(e.nodes_off, e.node_count, nodes)) return false;
+		if (!r.get(e.text_off, e.text_len, form_text)) return false;
+		if (e.offset > src.size() || e.root >= e.node_count) return false;
+
+		auto &form = forms[f];
+		form.offset = e.offset;
+		form.line = e.line;
+		form.column = e.column;
+		form.tree.root = e.root;
+		form.tree.nodes.assign(nodes, nodes + e.node_count);
+		form.tree.text.assign(form_text, e.text_len);
+		// checked, since a corrupt image must not make evaluation read out of bounds
+		const std::string_view form_src = src.substr(e.offset);
+		for (uint32_t i = 0; i < e.node_count; i++) {
+			auto &node = form.tree.nodes[i];
+			if ((uint8_t)node.type > (uint8_t)CST::Type::String
+			    || !valid_flag(node.synthetic) || !valid_flag(node.typed))
+				return false;
+			// only literals are made by the optimizer, with their text in the form
+			if (node.synthetic && node.type != CST::Type::Number
+			    && node.type != CST::Type::String)
+				return false;
+			const size_t limit = node.synthetic ? e.text_len : form_src.size();
+			if (node.beg > limit || node.len > limit - node.beg) return false;
+			if (node.type == CST::Type::App) {
+				if (node.first > i || node.count > i - node.first) return false;
+				node.typed = false;
+				continue;
+			}
+			if (node.count != 0) return false;
+			if (node.type != CST::Type::Symbol || is_builtin(node.sym)) continue;
+			const SymbolId sym = node.sym - builtin_count;
+			if (sym >= ids.size()) return false;
+			if (renumber) node.sym = ids[sym];
+		}
+		if (flags & image_checked) check_types(form.tree, form_src);
+	}
+	return true;
+}
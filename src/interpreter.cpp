@@ -0,0 +1,89 @@
+#include "interpreter.hpp"
+
+#include <string_view>
+
+#include "bigint.hpp"
+#include "cache.hpp"
+#include "eval.hpp"
+#include "gc.hpp"
+#include "io.hpp"
+#include "lex.hpp"
+#include "opt.hpp"
+#include "parse.hpp"
+#include "profile.hpp"
+#include "rope.hpp"
+#include "types.hpp"
+#include "vm.hpp"
+
+Interpreter::Interpreter(Options opts) : opts {opts}, heap {opts.gc} {}
+
+// copies a boxed value into the heap of the context
+static Value own(const Value &val) {
+	switch (val.type) {
+		case Value::Type::String: return value_string(value_text(val));
+		case Value::Type::Error: return value_error(*val.str);
+		case Value::Type::BigNumber: return value_big(BigInt(*val.big));
+		default: return val;
+	}
+}
+
+Value Interpreter::eval(std::string_view src) {
+	// an arena of the caller would take precedence
+	Arena *prev_arena = set_value_arena(nullptr);
+	Heap *prev_heap = set_value_heap(&heap);
+	std::string *prev_out = capture_output(opts.out);
+
+	Value val = value_nil();
+	if (opts.cache != nullptr) {
+		const auto prog = opts.cache->get(src);
+		if (prog->success()) {
+			val = prog->run(opts.vm);
+			// values of the VM point into the program, which may be evicted
+			if (opts.vm && prog->compiled) val = own(val);
+		} else {
+			const auto &form = prog->forms.back();
+			tree.errors = form.tree.errors;
+			val = value_error(form.ill_typed ? "Type error" : "Syntax error");
+		}
+		heap.pin(val);
+		capture_output(prev_out);
+		set_value_heap(prev_heap);
+		set_value_arena(prev_arena);
+		return val;
+	}
+
+	TokenStream tks(src);
+	while (parse_form(tks, tree)) {
+		if (!tree.success()) {
+			val = value_error("Syntax error");
+			break;
+		}
+		if (opts.typecheck && !check_types(tree, tks.text())) {
+			val = value_error("Type error");
+			break;
+		}
+		if (opts.fold) fold_constants(tree, tks.text());
+		if (opts.vm) {
+			code = compile(tree, tks.text());
+			val = run(code);
+			// values of the VM point into the bytecode, which is reused
+			val = own(val);
+		} else {
+			val = ::eval(tree, tks.text());
+		}
+		if (val.type == Value::Type::Error) break;
+	}
+	profile_spans("", src);
+
+	heap.pin(val);
+	capture_output(prev_out);
+	set_value_heap(prev_heap);
+	set_value_arena(prev_arena);
+	return val;
+}
+
+void Interpreter::reset() {
+	heap.unpin_all();
+	heap.collect([](Heap &) {});
+	tree.errors.clear();
+}
@@ -1,94 +1,322 @@
 #include "io.hpp"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+#include "bigint.hpp"
 #include "eval.hpp"
 #include "lex.hpp"
 #include "parse.hpp"
+#include "profile.hpp"
+#include "rope.hpp"
+#include "symbol.hpp"
+
+using str = std::string_view;
+
+// where the calling thread's output goes, stdout if null
+static thread_local std::string *captured = nullptr;
+
+std::string *capture_output(std::string *buf) {
+	std::string *prev = captured;
+	captured = buf;
+	return prev;
+}
+
+OutSink::OutSink(int fd, size_t capacity) : fd {fd}, buf(capacity) {}
+
+OutSink::~OutSink() { flush(); }
+
+// writes all of the buffers, retrying on short writes
+static void write_all(int fd, struct iovec *iov, int count) {
+	while (count > 0) {
+		ssize_t n = writev(fd, iov, count);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return;
+		}
+		for (; count > 0 && (size_t)n >= iov->iov_len; iov++, count--)
+			n -= (ssize_t)iov->iov_len;
+		if (count > 0) {
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= (size_t)n;
+		}
+	}
+}
+
+void OutSink::write_unlocked(std::string_view s) {
+	if (s.size() <= buf.size() - used) {
+		std::memcpy(buf.data() + used, s.data(), s.size());
+		used += s.size();
+		return;
+	}
+	if (s.size() < buf.size()) {
+		flush_unlocked();
+		std::memcpy(buf.data(), s.data(), s.size());
+		used = s.size();
+		return;
+	}
+	// too large to buffer, both go out in one call
+	struct iovec iov[2] = {
+		{buf.data(), used},
+		{(void *)s.data(), s.size()},
+	};
+	write_all(fd, iov, 2);
+	used = 0;
+}
+
+void OutSink::flush_unlocked() {
+	if (used == 0) return;
+	struct iovec iov = {buf.data(), used};
+	write_all(fd, &iov, 1);
+	used = 0;
+}
+
+void OutSink::write(std::string_view s) {
+	if (!locking) return write_unlocked(s);
+	std::lock_guard lock(mutex);
+	write_unlocked(s);
+}
+
+void OutSink::flush() {
+	if (!locking) return flush_unlocked();
+	std::lock_guard lock(mutex);
+	flush_unlocked();
+}
 
-using str = std::string;
+void OutSink::redirect(int fd) {
+	std::lock_guard lock(mutex);
+	flush_unlocked();
+	this->fd = fd;
+}
 
-void print_str(const std::string &src) {
-	for (size_t i = 0; i < src.length(); i++) printf("%c", src[i]);
+OutSink &stdout_sink() {
+	static OutSink sink(STDOUT_FILENO);
+	return sink;
+}
+
+void print_str(std::string_view src) {
+	if (captured != nullptr)
+		captured->append(src);
+	else
+		stdout_sink().write(src);
+}
+
+void print_rope(const Rope &rope) {
+	rope.for_each_piece([](std::string_view s) { print_str(s); });
+}
+
+void print_fmt(const char *fmt, ...) {
+	char buf[256];
+	va_list args;
+	va_start(args, fmt);
+	const int n = vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	if (n < 0) return;
+	if ((size_t)n < sizeof(buf)) {
+		print_str(std::string_view(buf, (size_t)n));
+		return;
+	}
+	std::string big((size_t)n + 1, '\0');
+	va_start(args, fmt);
+	vsnprintf(big.data(), big.size(), fmt, args);
+	va_end(args);
+	big.pop_back();
+	print_str(big);
 }
 
-std::string read_file(std::filesystem::path path) {
+void print_json_str(std::string_view src) {
+	print_str("\"");
+	size_t done = 0;
+	for (size_t i = 0; i < src.size(); i++) {
+		const auto c = (unsigned char)src[i];
+		if (c >= 0x20 && c != '"' && c != '\\') continue;
+		print_str(src.substr(done, i - done));
+		done = i + 1;
+		switch (c) {
+			case '"': print_str("\\\""); break;
+			case '\\': print_str("\\\\"); break;
+			case '\n': print_str("\\n"); break;
+			case '\t': print_str("\\t"); break;
+			default: print_fmt("\\u%04x", c); break;
+		}
+	}
+	print_str(src.substr(done));
+	print_str("\"");
+}
+
+MappedFile::MappedFile(const std::filesystem::path &path) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	struct stat st {};
+	if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED) {
+			map = p;
+			map_len = (size_t)st.st_size;
+			// the whole file is lexed front to back
+			madvise(map, map_len, MADV_SEQUENTIAL);
+			view = std::string_view((const char *)map, map_len);
+		}
+	}
+	if (fd >= 0) close(fd);
+	if (map != nullptr) return;
+
 	std::ifstream f(path, std::ios::in | std::ios::binary);
-	const auto sz = std::filesystem::file_size(path);
-	str result(sz, '\0');
-	f.read(result.data(), sz);
-	return result;
+	opened = f.is_open();
+	buf.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	view = buf;
 }
 
-void print_token(Token tk, const str &src) {
-	printf("Token (beg: %lu, len: %lu, str: \"", tk.beg, tk.len);
+MappedFile::~MappedFile() {
+	if (map != nullptr) munmap(map, map_len);
+}
+
+TokenStream::Reader fd_reader(int fd) {
+	return [fd](char *buf, size_t cap) -> size_t {
+		while (true) {
+			const ssize_t n = read(fd, buf, cap);
+			if (n >= 0) return (size_t)n;
+			if (errno != EINTR) return 0;
+		}
+	};
+}
+
+void print_errors(
+	str name, const CST &tree, str src, size_t first_line, size_t first_column
+) {
+	// errors are sorted, so lines are counted in one pass
+	size_t line = first_line;
+	size_t line_beg = 0;
+	size_t line_column = first_column; // of line_beg
+	size_t scanned = 0;
+	for (auto &err : tree.errors) {
+		const size_t pos = err.beg < src.length() ? err.beg : src.length();
+		for (; scanned < pos; scanned++)
+			if (src[scanned] == '\n') {
+				line++;
+				line_beg = scanned + 1;
+				line_column = 1;
+			}
+		if (!name.empty()) {
+			print_str(name);
+			print_fmt(":");
+		}
+		print_fmt("%zu:%zu: %s\n", line, pos - line_beg + line_column, err.msg.c_str());
+	}
+}
+
+void print_token(Token tk, str src) {
+	print_fmt("Token (beg: %lu, len: %lu, str: \"", tk.beg, tk.len);
 	for (size_t i = 0; i < tk.len; i++)
 		if (src[tk.beg + i] == '\n')
-			printf("\\n");
+			print_fmt("\\n");
 		else
-			printf("%c", src[tk.beg + i]);
-	printf("\")\n");
+			print_fmt("%c", src[tk.beg + i]);
+	print_fmt("\")\n");
 }
 
-void print_node(CST::Node *node, const str &src) {
-	switch (node->type) {
-		case CST::Type::App:
-			printf("(");
-			for (auto child : node->children) {
-				print_node(child, src);
-				printf(" ");
-			}
-			printf(")");
-			break;
+static void print_leaf(const CST &tree, const CST::Node &node, str src) {
+	switch (node.type) {
+		case CST::Type::App: break;
 		case CST::Type::Number:
 		case CST::Type::Symbol: {
-			str num = src.substr(node->beg, node->len);
-			printf("'");
-			print_str(num);
+			print_fmt("'");
+			print_str(tree.text_of(node, src));
 			break;
 		}
 		case CST::Type::String: {
-			str num = src.substr(node->beg, node->len);
-			printf("\"");
-			print_str(num);
-			printf("\"");
+			print_fmt("\"");
+			print_str(tree.text_of(node, src));
+			print_fmt("\"");
 			break;
 		}
 	}
-	return;
 }
 
-void print_tree(const CST &tree, const str &src) { print_node(tree.root, src); }
+// iterative, since trees may be nested deeper than the native stack allows
+void print_node(const CST &tree, const CST::Node &node, str src) {
+	// applications being printed, with their next child
+	std::vector<std::pair<const CST::Node *, uint32_t>> apps;
+	const CST::Node *next = &node;
+	while (true) {
+		if (next != nullptr) {
+			if (next->type != CST::Type::App) {
+				print_leaf(tree, *next, src);
+				next = nullptr;
+			} else {
+				print_fmt("(");
+				apps.emplace_back(next, 0);
+			}
+		}
+
+		if (apps.empty()) return;
+		auto &[app, child] = apps.back();
+		// a child was just printed
+		if (next == nullptr) print_fmt(" ");
+		if (child < app->count) {
+			next = &tree.nodes[app->first + child++];
+			continue;
+		}
+		print_fmt(")");
+		apps.pop_back();
+		next = nullptr;
+	}
+}
+
+void print_tree(const CST &tree, str src) {
+	print_node(tree, tree.root_node(), src);
+}
 
 void print_value(const Value &val) {
+	ProfileScope scope(Phase::Print);
 	switch (val.type) {
 		case Value::Type::Number: {
-			printf("= %ld : Number", *(int64_t *)val.box);
+			print_fmt("= %ld : Number", val.num);
+			break;
+		}
+		case Value::Type::BigNumber: {
+			print_str("= ");
+			print_str(val.big->to_string());
+			print_str(" : Number");
 			break;
 		}
 		case Value::Type::Symbol: {
-			printf("= \'");
-			print_str(*(std::string *)val.box);
-			printf(" : Symbol");
+			print_fmt("= \'");
+			print_str(symbol_name(val.sym));
+			print_fmt(" : Symbol");
 			break;
 		}
 		case Value::Type::String: {
-			printf("= \"");
-			print_str(*(std::string *)val.box);
-			printf("\"");
-			printf(" : String");
+			print_fmt("= \"");
+			print_rope(*val.rope);
+			print_fmt("\"");
+			print_fmt(" : String");
 			break;
 		}
 		case Value::Type::Nil: {
-			printf("nil");
+			print_fmt("nil");
 			break;
 		}
 		case Value::Type::Error:
-			printf("= ");
-			print_str(*(std::string *)val.box);
-			printf(" : Error");
+			print_fmt("= ");
+			print_str(*val.str);
+			print_fmt(" : Error");
 			break;
 	}
-	printf("\n");
+	print_fmt("\n");
 }
@@ -1,100 +1,227 @@
 #include "lex.hpp"
 
+#include <algorithm>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
-using str = std::string;
+#include "profile.hpp"
+#include "scan.hpp"
+#include "symbol.hpp"
 
-#define TOK_FIXED_SZ(SZ, TOKEN)                         \
-	tks.push_back(Token {index, SZ, Token::Type::TOKEN}); \
+using str = std::string_view;
+
+#define TOK_FIXED_SZ(SZ, TOKEN)             \
+	tk = Token {index, SZ, Token::Type::TOKEN}; \
 	index += SZ;
 
-Token tokenize_number(str &src, size_t index) {
+// The source isn't necessarily null terminated, so reads past the end give a
+// null character instead.
+static char at(str src, size_t index) {
+	return index < src.length() ? src[index] : '\0';
+}
+
+Token tokenize_number(str src, size_t index) {
 	Token res {index, 1, Token::Type::Number};
-	if (src[index] == '0' && (src[index + 1] == 'x' || src[index + 1] == 'b')) {
+	if (src[index] == '0' && (at(src, index + 1) == 'x' || at(src, index + 1) == 'b')) {
 		res.len += 1;
 	}
-	while (true)
-		if ('0' <= src[index + res.len] && src[index + res.len] <= '9')
-			res.len += 1;
-		else
-			break;
+	res.len += scan(ScanClass::Digit, src.substr(index + res.len));
 	return res;
 }
 
-Token tokenize_word(str &src, size_t index) {
+Token tokenize_word(str src, size_t index) {
 	Token res {index, 1, Token::Type::Word};
-	while (true)
-		if (('a' <= src[index + res.len] && src[index + res.len] <= 'z') || ('A' <= src[index + res.len] && src[index + res.len] <= 'Z'))
-			res.len += 1;
-		else
-			break;
+	res.len += scan(ScanClass::Alpha, src.substr(index + res.len));
 	return res;
 }
 
+// Lexes the next token at index and moves index past it. Returns false at the
+// end of source.
+static bool lex_token(str src, size_t &index, Token &tk) {
+	if (index >= src.length()) return false;
+	switch (src[index]) {
+		case '+': TOK_FIXED_SZ(1, Plus); return true;
+		case '-': TOK_FIXED_SZ(1, Minus); return true;
+		case '*': TOK_FIXED_SZ(1, Star); return true;
+		case '=': TOK_FIXED_SZ(1, Equal); return true;
+		case '&': TOK_FIXED_SZ(1, Ampersand); return true;
+		case '/': TOK_FIXED_SZ(1, Slash); return true;
+		case '!': TOK_FIXED_SZ(1, Bang); return true;
+		case '%': TOK_FIXED_SZ(1, Percent); return true;
+		case '^': TOK_FIXED_SZ(1, Caret); return true;
+		case '(': TOK_FIXED_SZ(1, ParenOpen); return true;
+		case ')': TOK_FIXED_SZ(1, ParenClose); return true;
+		case '[': TOK_FIXED_SZ(1, BracketOpen); return true;
+		case ']': TOK_FIXED_SZ(1, BracketClose); return true;
+		case '{': TOK_FIXED_SZ(1, BraceOpen); return true;
+		case '}': TOK_FIXED_SZ(1, BraceClose); return true;
+		case '<': TOK_FIXED_SZ(1, LeftAngled); return true;
+		case '>': TOK_FIXED_SZ(1, RightAngled); return true;
+		case '\n': TOK_FIXED_SZ(1, Newline); return true;
+		case ';': TOK_FIXED_SZ(1, Semicolon); return true;
+		case ',': TOK_FIXED_SZ(1, Comma); return true;
+		case '\'': TOK_FIXED_SZ(1, SingleQuote); return true;
+		case '"': {
+			size_t read = 1 + scan(ScanClass::NotQuote, src.substr(index + 1));
+			if (index + read < src.length()) read++; // closing quote
+			tk = Token {index, read, Token::Type::String};
+			index += read;
+			return true;
+		}
+		case ' ': {
+			size_t read = 1;
+			read += scan(ScanClass::Space, src.substr(index + read));
+			tk = Token {index, read, Token::Type::Spaces};
+			index += read;
+			return true;
+		}
+		case '\t': {
+			size_t read = 1;
+			read += scan(ScanClass::Tab, src.substr(index + read));
+			tk = Token {index, read, Token::Type::Tabs};
+			index += read;
+			return true;
+		}
+		default:
+			if (('a' <= src[index] && src[index] <= 'z') || ('A' <= src[index] && src[index] <= 'Z')) {
+				tk = tokenize_word(src, index);
+				index += tk.len;
+				return true;
+			} else if ('0' <= src[index] && src[index] <= '9') {
+				tk = tokenize_number(src, index);
+				index += tk.len;
+				return true;
+			}
+			TOK_FIXED_SZ(1, Unknown);
+			return true;
+	}
+}
+
+bool is_word(const Token &tk) {
+	switch (tk.type) {
+		case Token::Type::Plus:
+		case Token::Type::Minus:
+		case Token::Type::Star:
+		case Token::Type::Slash:
+		case Token::Type::Equal:
+		case Token::Type::Ampersand:
+		case Token::Type::Bang:
+		case Token::Type::Percent:
+		case Token::Type::Caret:
+		case Token::Type::BracketOpen:
+		case Token::Type::BracketClose:
+		case Token::Type::BraceOpen:
+		case Token::Type::BraceClose:
+		case Token::Type::LeftAngled:
+		case Token::Type::RightAngled:
+		case Token::Type::Word:
+		case Token::Type::Semicolon:
+		case Token::Type::Comma: return true;
+
+		case Token::Type::Number:
+		case Token::Type::String:
+		case Token::Type::SingleQuote:
+		case Token::Type::ParenOpen:
+		case Token::Type::ParenClose:
+		case Token::Type::Tabs:
+		case Token::Type::Spaces:
+		case Token::Type::Newline:
+		case Token::Type::Unknown: return false;
+	}
+	return false;
+}
+
+bool is_space(const Token &tk) {
+	return tk.type == Token::Type::Spaces || tk.type == Token::Type::Tabs
+	    || tk.type == Token::Type::Newline;
+}
+
 std::vector<Token> tokenize(str src) {
+	ProfileScope scope(Phase::Tokenize);
 	std::vector<Token> tks;
 	size_t index = 0;
+	Token tk;
+	while (lex_token(src, index, tk)) {
+		if (is_word(tk)) tk.sym = intern(src.substr(tk.beg, tk.len));
+		tks.push_back(tk);
+	}
+	return tks;
+}
+
+// whether the token could continue past the end of the buffered source
+static bool can_extend(Token::Type type) {
+	switch (type) {
+		case Token::Type::Number:
+		case Token::Type::Word:
+		case Token::Type::String:
+		case Token::Type::Spaces:
+		case Token::Type::Tabs: return true;
+		default: return false;
+	}
+}
+
+TokenStream::TokenStream(str src) : src {src} {}
+
+TokenStream::TokenStream(Reader reader, size_t chunk_size)
+: reader {std::move(reader)}, chunk_size {chunk_size} {}
+
+bool TokenStream::refill() {
+	if (!reader || eof) return false;
+	// compact only when reading, instead of on every discard
+	buf.erase(0, start);
+	start = 0;
+	const size_t old = buf.size();
+	buf.resize(old + chunk_size);
+	const size_t read = reader(buf.data() + old, chunk_size);
+	buf.resize(old + read);
+	src = buf;
+	if (read == 0) eof = true;
+	return read > 0;
+}
+
+bool TokenStream::lex(Token &tk) {
+	ProfileScope scope(Phase::Tokenize);
 	while (true) {
-		if (index >= src.length()) return tks;
-		switch (src[index]) {
-			case '+': TOK_FIXED_SZ(1, Plus); break;
-			case '-': TOK_FIXED_SZ(1, Minus); break;
-			case '*': TOK_FIXED_SZ(1, Star); break;
-			case '=': TOK_FIXED_SZ(1, Equal); break;
-			case '&': TOK_FIXED_SZ(1, Ampersand); break;
-			case '/': TOK_FIXED_SZ(1, Slash); break;
-			case '!': TOK_FIXED_SZ(1, Bang); break;
-			case '%': TOK_FIXED_SZ(1, Percent); break;
-			case '^': TOK_FIXED_SZ(1, Caret); break;
-			case '(': TOK_FIXED_SZ(1, ParenOpen); break;
-			case ')': TOK_FIXED_SZ(1, ParenClose); break;
-			case '[': TOK_FIXED_SZ(1, BracketOpen); break;
-			case ']': TOK_FIXED_SZ(1, BracketClose); break;
-			case '{': TOK_FIXED_SZ(1, BraceOpen); break;
-			case '}': TOK_FIXED_SZ(1, BraceClose); break;
-			case '<': TOK_FIXED_SZ(1, LeftAngled); break;
-			case '>': TOK_FIXED_SZ(1, RightAngled); break;
-			case '\n': TOK_FIXED_SZ(1, Newline); break;
-			case ';': TOK_FIXED_SZ(1, Semicolon); break;
-			case ',': TOK_FIXED_SZ(1, Comma); break;
-			case '\'': TOK_FIXED_SZ(1, SingleQuote); break;
-			case '"': {
-				size_t read = 1;
-				while (src[index + read++] != '"')
-					;
-				Token tk = Token {index, read, Token::Type::String};
-				tks.push_back(tk);
-				index += read;
-				break;
-			}
-			case ' ': {
-				size_t read = 1;
-				while (src[index + read] == ' ') read++;
-				Token tk = Token {index, read, Token::Type::Spaces};
-				tks.push_back(tk);
-				index += read;
-				break;
-			}
-			case '\t': {
-				size_t read = 1;
-				while (src[index + read] == '\t') read++;
-				Token tk = Token {index, read, Token::Type::Tabs};
-				tks.push_back(tk);
-				index += read;
-				break;
-			}
-			default:
-				if (('a' <= src[index] && src[index] <= 'z') || ('A' <= src[index] && src[index] <= 'Z')) {
-					Token tk = tokenize_word(src, index);
-					tks.push_back(tk);
-					index += tk.len;
-				} else if ('0' <= src[index] && src[index] <= '9') {
-					Token tk = tokenize_number(src, index);
-					tks.push_back(tk);
-					index += tk.len;
-				}
-				break;
+		size_t index = pos;
+		if (!lex_token(src, index, tk)) {
+			pos = src.length();
+			if (refill()) continue;
+			return false;
 		}
+		// lex it again once more input is buffered
+		if (index == src.length() && can_extend(tk.type) && refill()) continue;
+		pos = index;
+		// only once it can't be extended, or a prefix would be interned too
+		if (is_word(tk)) tk.sym = intern(src.substr(tk.beg, tk.len));
+		if (!is_space(tk)) return true;
+	}
+}
+
+bool TokenStream::peek(Token &tk) {
+	if (!peeked) {
+		if (!lex(ahead)) return false;
+		peeked = true;
 	}
+	tk = ahead;
+	return true;
+}
+
+bool TokenStream::next(Token &tk) {
+	if (!peek(tk)) return false;
+	peeked = false;
+	return true;
+}
+
+void TokenStream::discard() {
+	size_t drop = peeked ? ahead.beg : pos;
+	const auto dropped = src.substr(0, drop);
+	first_line += (size_t)std::count(dropped.begin(), dropped.end(), '\n');
+	const size_t nl = dropped.rfind('\n');
+	first_column = nl == str::npos ? first_column + drop : drop - nl;
+	start += drop;
+	src.remove_prefix(drop);
+	pos -= drop;
+	if (peeked) ahead.beg -= drop;
 }
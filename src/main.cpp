@@ -1,59 +1,428 @@
 #include <assert.h>
 #include <stdio.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <new>
 #include <span>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
+#include "alloc.hpp"
+#include "cache.hpp"
 #include "eval.hpp"
+#include "gc.hpp"
+#include "image.hpp"
 #include "io.hpp"
 #include "lex.hpp"
+#include "opt.hpp"
 #include "parse.hpp"
+#include "pool.hpp"
+#include "profile.hpp"
+#include "symbol.hpp"
+#include "types.hpp"
+#include "vm.hpp"
 
 using str = std::string;
 
-int run_file(const char *filename) {
-	const auto src = read_file(filename);
-	auto tks = tokenize(src);
-	const auto tree = parse(tks);
-	if (!tree.success) {
-		printf("Parsing error!\n");
-		return 1;
+struct Options {
+	bool vm = false;    // run on the bytecode VM instead of the tree walker
+	bool check = false; // only report syntax and type errors, without evaluating
+	bool typecheck = true; // reject ill-typed forms before running them
+	bool fold = false;  // fold constant applications before running
+	bool dump = false;  // print each optimized tree and what was folded
+	size_t jobs = 0;    // threads of the pool, 0 for the default
+	bool batch = false; // run every file given, concurrently
+	bool json = false;  // report batch results as JSON lines
+	bool cache_stats = false; // print program cache counters on leaving the REPL
+	bool image = true;  // load and save compiled images next to source files
+	Heap::Options gc;   // tuning of the heap of each run
+	bool gc_stats = false; // print collector counters before exiting
+	bool symbol_stats = false; // print what interning symbols saved before exiting
+	bool profile = false; // print where time and memory went before exiting
+	const char *profile_out = nullptr; // and write it as a Chrome trace there
+};
+
+Options opts;
+std::unique_ptr<Pool> pool;
+
+// the bytecode backs the strings of the value, so it's handed to the caller
+Value execute(const CST &tree, std::string_view src, Bytecode &code) {
+	if (!opts.vm) return pool ? eval(tree, src, *pool) : eval(tree, src);
+	code = compile(tree, src);
+	return run(code);
+}
+
+Value run(CST &tree, std::string_view src, Bytecode &code) {
+	if (opts.fold) {
+		const auto stats = fold_constants(tree, src);
+		if (opts.dump) {
+			print_tree(tree, src);
+			print_fmt(
+				"\n; folded %zu, merged %zu, removed %zu\n",
+				stats.folded,
+				stats.merged,
+				stats.removed
+			);
+		}
+	} else if (opts.dump) {
+		print_tree(tree, src);
+		print_fmt("\n");
+	}
+	return execute(tree, src, code);
+}
+
+// The forms of a stream, kept as they run so they can be saved as an image.
+struct Recording {
+	const char *src; // that the text of the stream is in
+	std::vector<Program::Form> forms;
+	bool complete = false; // the whole stream was parsed without errors
+};
+
+// Evaluates top-level forms as soon as they are parsed, stopping at the first
+// error. Prints the value of the last one. When checking, every form is parsed
+// and all syntax and type errors are reported instead.
+int run_stream(std::string_view name, TokenStream &tks, Recording *rec = nullptr) {
+	CST tree;
+	Bytecode code;
+	Value val = value_nil();
+	bool failed = false;
+	while (parse_form(tks, tree)) {
+		if (opts.typecheck) check_types(tree, tks.text());
+		if (!tree.success()) {
+			print_errors(name, tree, tks.text(), tks.line(), tks.column());
+			failed = true;
+			if (opts.check) continue;
+			return 1;
+		}
+		if (opts.check) continue;
+		val = run(tree, tks.text(), code);
+		// the text is dropped with the next form
+		profile_spans(name, tks.text(), tks.line(), tks.column());
+		if (rec != nullptr) {
+			Program::Form form {};
+			form.offset = (size_t)(tks.text().data() - rec->src);
+			form.line = tks.line();
+			form.column = tks.column();
+			form.tree = std::move(tree);
+			rec->forms.push_back(std::move(form));
+		}
+		if (val.type == Value::Type::Error) break;
+	}
+	if (opts.check) return failed;
+	if (rec != nullptr) rec->complete = val.type != Value::Type::Error;
+	print_value(val);
+	return val.type == Value::Type::Error;
+}
+
+// Runs forms parsed beforehand, like run_stream
+int run_forms(
+	std::string_view name, std::string_view src, const std::vector<Program::Form> &forms
+) {
+	Bytecode code;
+	Value val = value_nil();
+	for (auto &form : forms) {
+		const auto text = src.substr(form.offset);
+		if (!form.tree.success()) {
+			print_errors(name, form.tree, text, form.line, form.column);
+			return 1;
+		}
+		val = execute(form.tree, text, code);
+		profile_spans(name, text, form.line, form.column);
+		if (val.type == Value::Type::Error) break;
 	}
-	const auto val = eval(tree, src);
 	print_value(val);
 	return val.type == Value::Type::Error;
 }
 
+// Runs the image next to the file if it's fresh. Otherwise the file is run
+// as a stream, and its forms are saved as an image for the next run.
+int run_imaged_file(const char *filename) {
+	SourceStamp stamp;
+	if (!source_stamp(filename, stamp)) {
+		print_fmt("Could not read %s\n", filename);
+		return 1;
+	}
+	const uint32_t flags =
+		(opts.fold ? image_folded : 0) | (opts.typecheck ? image_checked : 0);
+	const auto path = image_path(filename);
+	{
+		Image image(path);
+		if (image.load(stamp, flags)) return run_forms(filename, image.src, image.forms);
+	}
+
+	const MappedFile file(filename);
+	if (!file.ok()) {
+		print_fmt("Could not read %s\n", filename);
+		return 1;
+	}
+	TokenStream tks(file.text());
+	Recording rec {file.text().data(), {}, false};
+	const int status = run_stream(filename, tks, &rec);
+	// best effort, the directory may not be writable
+	if (rec.complete) save_image(path, file.text(), rec.forms, stamp, flags);
+	return status;
+}
+
+int run_file(const char *filename) {
+	if (std::string_view(filename) == "-") {
+		TokenStream tks(fd_reader(STDIN_FILENO));
+		return run_stream("stdin", tks);
+	}
+	// checking and dumping want every form as it's parsed
+	if (opts.image && !opts.check && !opts.dump) return run_imaged_file(filename);
+	const MappedFile file(filename);
+	if (!file.ok()) {
+		print_fmt("Could not read %s\n", filename);
+		return 1;
+	}
+	TokenStream tks(file.text());
+	return run_stream(filename, tks);
+}
+
+// what running one file of a batch printed and returned
+struct BatchResult {
+	const char *name;
+	std::string out;
+	int status;
+	std::chrono::steady_clock::duration time;
+};
+
+static void run_batch_file(void *arg) {
+	auto res = (BatchResult *)arg;
+	const auto start = std::chrono::steady_clock::now();
+	// a thread waiting in another file may be running this one, so its capture
+	// is put back afterwards
+	std::string *prev = capture_output(&res->out);
+	Heap heap(opts.gc);
+	Heap *prev_heap = set_value_heap(&heap);
+	res->status = run_file(res->name);
+	set_value_heap(prev_heap);
+	capture_output(prev);
+	res->time = std::chrono::steady_clock::now() - start;
+}
+
+// Runs every file on the pool, then reports them in the order given. Returns
+// failure if any of them failed.
+int run_batch(const std::vector<const char *> &files) {
+	std::vector<BatchResult> results(files.size());
+	Pool::Group group;
+	for (size_t i = 0; i < files.size(); i++) {
+		results[i].name = files[i];
+		pool->spawn(group, run_batch_file, &results[i]);
+	}
+	pool->wait(group);
+
+	int status = 0;
+	for (auto &res : results) {
+		const double ms = std::chrono::duration<double, std::milli>(res.time).count();
+		if (opts.json) {
+			print_fmt("{\"file\": ");
+			print_json_str(res.name);
+			print_fmt(", \"status\": %d, \"time_ms\": %.3f, \"output\": ", res.status, ms);
+			print_json_str(res.out);
+			print_fmt("}\n");
+		} else {
+			print_fmt("==> %s (status %d, %.3f ms)\n", res.name, res.status, ms);
+			print_str(res.out);
+		}
+		if (res.status != 0) status = 1;
+	}
+	return status;
+}
+
+// paths listed one per line, skipping blank lines
+bool read_manifest(const char *path, std::vector<str> &out) {
+	std::ifstream f(path);
+	if (!f) return false;
+	str line;
+	while (std::getline(f, line))
+		if (line.find_first_not_of(" \t\r") != str::npos) out.push_back(line);
+	return true;
+}
+
+// Lines seen before are taken from the cache instead of parsed again.
 int run_repl() {
 	std::string src;
+	ProgramCache cache({.check = opts.typecheck, .fold = opts.fold, .compile = opts.vm});
 
 	while (true) {
-		printf("> ");
+		print_str("> ");
+		// the prompt must show before blocking on input
+		stdout_sink().flush();
 		std::getline(std::cin, src);
 		if (src == "") break;
-		auto tks = tokenize(src);
-		const auto tree = parse(tks);
-		if (!tree.success) {
-			printf("Parsing error!\n");
+		const auto prog = cache.get(src);
+		if (!prog->success()) {
+			auto &form = prog->forms.back();
+			print_errors("", form.tree, prog->text(form), form.line, form.column);
 			continue;
 		}
-		const auto val = eval(tree, src);
-		print_value(val);
+		if (opts.dump)
+			for (auto &form : prog->forms) {
+				print_tree(form.tree, prog->text(form));
+				print_fmt("\n");
+			}
+		print_value(prog->run(opts.vm));
 	}
 
+	if (opts.cache_stats) {
+		const auto st = cache.stats();
+		print_fmt(
+			"; cache: %zu hits, %zu misses, %zu evictions, %zu entries, %zu bytes\n",
+			st.hits,
+			st.misses,
+			st.evictions,
+			st.entries,
+			st.bytes
+		);
+	}
 	return 0;
 }
 
+static void print_gc_stats(const Heap::Stats &st) {
+	print_fmt(
+		"; gc: %zu collections (%zu minor), %zu bytes collected (%zu objects), "
+		"%zu bytes live, %.3f ms paused (%.3f ms max)\n",
+		st.collections,
+		st.minor_collections,
+		st.collected,
+		st.objects_collected,
+		st.bytes,
+		(double)st.pause_ns / 1e6,
+		(double)st.max_pause_ns / 1e6
+	);
+}
+
+static void print_symbol_stats(const SymbolStats &st) {
+	print_fmt(
+		"; symbols: %zu unique, %zu references, %zu bytes in the table, "
+		"%zu bytes as strings, %zu bytes saved\n",
+		st.unique,
+		st.references,
+		st.table_bytes,
+		st.string_bytes,
+		st.saved_bytes
+	);
+}
+
+// Reports the profile if asked to, and returns the status to exit with
+static int report_profile(int status) {
+	if (opts.profile) print_profile();
+	if (opts.profile_out != nullptr && !write_profile(opts.profile_out)) {
+		print_fmt("Could not write %s\n", opts.profile_out);
+		return 1;
+	}
+	return status;
+}
+
+static int usage(const char *prog) {
+	print_fmt(
+		"Usage: %s [--vm] [--check] [-O] [--dump-tree] [--jobs N] [--no-image] [--no-typecheck]\n"
+		"          [FILE | -]\n"
+		"       %s [OPTION...] [--cache-stats]\n"
+		"       %s --batch [--json] [--manifest LIST] [OPTION...] [FILE...]\n"
+		"GC options: [--no-gc] [--gc-threshold BYTES] [--gc-growth FACTOR] [--gc-nursery BYTES]\n"
+		"            [--gc-stats]\n"
+		"Memory report: [--symbol-stats]\n"
+		"Profiling: [--profile] [--profile-out TRACE.json]\n",
+		prog,
+		prog,
+		prog
+	);
+	return 1;
+}
+
 int main(int argc, char *argv[]) {
-	if (argc == 1) {
-		return run_repl();
-	} else {
-		return run_file(argv[1]);
+	std::vector<const char *> files;
+	std::vector<str> manifest;
+	for (int i = 1; i < argc; i++) {
+		const std::string_view arg = argv[i];
+		if (arg == "--vm")
+			opts.vm = true;
+		else if (arg == "--check")
+			opts.check = true;
+		else if (arg == "-O" || arg == "--fold")
+			opts.fold = true;
+		else if (arg == "--dump-tree")
+			opts.dump = true;
+		else if (arg == "--jobs" && i + 1 < argc)
+			opts.jobs = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--no-typecheck")
+			opts.typecheck = false;
+		else if (arg == "--no-image")
+			opts.image = false;
+		else if (arg == "--cache-stats")
+			opts.cache_stats = true;
+		else if (arg == "--batch")
+			opts.batch = true;
+		else if (arg == "--json")
+			opts.json = true;
+		else if (arg == "--no-gc")
+			opts.gc.enabled = false;
+		else if (arg == "--gc-threshold" && i + 1 < argc)
+			opts.gc.threshold = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--gc-growth" && i + 1 < argc)
+			opts.gc.growth = std::max(1.0, std::strtod(argv[++i], nullptr));
+		else if (arg == "--gc-nursery" && i + 1 < argc)
+			opts.gc.nursery = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--gc-stats")
+			opts.gc_stats = true;
+		else if (arg == "--symbol-stats")
+			opts.symbol_stats = true;
+		else if (arg == "--profile")
+			opts.profile = true;
+		else if (arg == "--profile-out" && i + 1 < argc)
+			opts.profile_out = argv[++i];
+		else if (arg == "--manifest" && i + 1 < argc) {
+			opts.batch = true;
+			if (!read_manifest(argv[++i], manifest)) {
+				print_fmt("Could not read manifest %s\n", argv[i]);
+				return 1;
+			}
+		} else if (arg.starts_with("--"))
+			return usage(argv[0]);
+		else
+			files.push_back(argv[i]);
 	}
+	for (auto &path : manifest) files.push_back(path.c_str());
+
+	// only the main thread prints, tasks of a batch capture their output
+	stdout_sink().set_locking(false);
+	profile_on = opts.profile || opts.profile_out != nullptr;
+	// allocations are only counted for the profiler
+	if (profile_on) set_alloc_hook(profile_alloc);
+
+	if (opts.batch) {
+		if (opts.jobs == 0) opts.jobs = std::max(1u, std::thread::hardware_concurrency());
+		pool = std::make_unique<Pool>(opts.jobs);
+		const int status = run_batch(files);
+		if (opts.symbol_stats) print_symbol_stats(symbol_stats());
+		return report_profile(status);
+	}
+
+	// the VM runs a program on one thread, only batches spread over the pool
+	if (opts.vm && opts.jobs > 1) {
+		print_fmt("--jobs only applies to the tree walker, or with --batch\n");
+		return 1;
+	}
+	if (opts.jobs > 1) pool = std::make_unique<Pool>(opts.jobs);
+
+	if (files.size() > 1) return usage(argv[0]);
+
+	Heap heap(opts.gc);
+	set_value_heap(&heap);
+	const int status = files.empty() ? run_repl() : run_file(files[0]);
+	if (opts.gc_stats) print_gc_stats(heap.stats());
+	if (opts.symbol_stats) print_symbol_stats(symbol_stats());
+	return report_profile(status);
 }
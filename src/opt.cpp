@@ -0,0 +1,149 @@
+#include "opt.hpp"
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bigint.hpp"
+#include "eval.hpp"
+#include "parse.hpp"
+#include "profile.hpp"
+#include "rope.hpp"
+#include "symbol.hpp"
+
+// Results of more limbs are left to run time, as printing them as a literal
+// and parsing that back would take longer than computing them again.
+static constexpr size_t max_folded_limbs = 64;
+// Likewise for strings, whose literal text is copied at every level folded.
+// Past this, cat links ropes at run time instead.
+static constexpr size_t max_folded_bytes = 4096;
+
+// builtins without side effects
+static bool is_pure(SymbolId sym) {
+	switch ((Builtin)sym) {
+		case Builtin::Put:
+		case Builtin::Println: return false;
+		default: return is_builtin(sym);
+	}
+}
+
+static bool is_literal(const CST::Node &node) {
+	return node.type == CST::Type::Number || node.type == CST::Type::String;
+}
+
+// makes node a synthetic literal with the given text
+static void set_literal(
+	CST &tree, CST::Node &node, CST::Type type, std::string_view text
+) {
+	node = CST::Node {};
+	node.type = type;
+	node.synthetic = true;
+	node.beg = tree.text.size();
+	node.len = text.size();
+	tree.text += text;
+}
+
+static Value literal_value(
+	const CST &tree, const CST::Node &node, std::string_view src
+) {
+	const auto repr = tree.text_of(node, src);
+	if (node.type == CST::Type::String) return value_string(repr);
+	return value_number(repr);
+}
+
+// Concatenates runs of adjacent string literals among the arguments of cat,
+// which shrinks its range of children.
+static void merge_strings(
+	CST &tree, CST::Node &app, std::string_view src, FoldStats &stats
+) {
+	CST::Node *children = tree.nodes.data() + app.first;
+	CST::Index out = 1;
+	for (CST::Index i = 1; i < app.count; out++) {
+		// runs are split where they would outgrow a folded string
+		CST::Index j = i + 1;
+		size_t bytes = children[i].len;
+		while (j < app.count && children[i].type == CST::Type::String
+		       && children[j].type == CST::Type::String
+		       && bytes + children[j].len <= max_folded_bytes)
+			bytes += children[j++].len;
+		if (j - i > 1) {
+			std::string acc;
+			for (CST::Index k = i; k < j; k++) acc += tree.text_of(children[k], src);
+			set_literal(tree, children[out], CST::Type::String, acc);
+			stats.merged += j - i - 1;
+			stats.removed += j - i - 1;
+		} else {
+			children[out] = children[i];
+		}
+		i = j;
+	}
+	app.count = out;
+}
+
+// Drops the text of the literals folded into their parents. Those are no
+// longer reachable from the root, and keep an empty range.
+static void compact_text(CST &tree) {
+	std::vector<bool> live(tree.nodes.size());
+	std::vector<CST::Index> todo {tree.root};
+	while (!todo.empty()) {
+		const CST::Index i = todo.back();
+		todo.pop_back();
+		live[i] = true;
+		const auto &node = tree.nodes[i];
+		for (CST::Index c = 0; c < node.count; c++) todo.push_back(node.first + c);
+	}
+
+	std::string text;
+	for (size_t i = 0; i < tree.nodes.size(); i++) {
+		auto &node = tree.nodes[i];
+		if (!node.synthetic) continue;
+		const size_t beg = text.size();
+		if (live[i]) text += std::string_view(tree.text).substr(node.beg, node.len);
+		node.beg = beg;
+		node.len = text.size() - beg;
+	}
+	tree.text = std::move(text);
+}
+
+FoldStats fold_constants(CST &tree, std::string_view src) {
+	ProfileScope scope(Phase::Fold);
+	FoldStats stats {};
+	std::vector<Value> args;
+
+	// children always come before their parent in the node array, so a single
+	// pass folds bottom up
+	for (auto &node : tree.nodes) {
+		if (node.type != CST::Type::App || node.count == 0) continue;
+		const CST::Node &head = tree.nodes[node.first];
+		if (head.type != CST::Type::Symbol || !is_pure(head.sym)) continue;
+
+		if ((Builtin)head.sym == Builtin::Cat) merge_strings(tree, node, src, stats);
+
+		args.clear();
+		const auto children = tree.children(node);
+		for (size_t i = 1; i < children.size(); i++) {
+			if (!is_literal(children[i])) break;
+			args.push_back(literal_value(tree, children[i], src));
+		}
+		if (args.size() != children.size() - 1) continue;
+
+		const Value res = builtins[head.sym](args);
+		if (res.type == Value::Type::Number) {
+			set_literal(tree, node, CST::Type::Number, std::to_string(res.num));
+		} else if (res.type == Value::Type::BigNumber) {
+			if (res.big->mag.size() > max_folded_limbs) continue;
+			set_literal(tree, node, CST::Type::Number, res.big->to_string());
+		} else if (res.type == Value::Type::String) {
+			if (res.rope->size() > max_folded_bytes) continue;
+			set_literal(tree, node, CST::Type::String, value_text(res));
+		} else {
+			continue;
+		}
+		stats.folded++;
+		stats.removed += children.size();
+	}
+
+	if (!tree.text.empty()) compact_text(tree);
+	return stats;
+}
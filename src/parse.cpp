@@ -2,128 +2,192 @@
 
 #include <assert.h>
 
-size_t parse_word(const std::span<Token> &tks, CST::Node **root) {
-	*root = new CST::Node;
-	(*root)->type = CST::Type::Symbol;
-	(*root)->beg = tks[0].beg;
-	(*root)->len = tks[0].len;
-	return 1;
-}
-
-size_t parse_string(const std::span<Token> &tks, CST::Node **root) {
-	*root = new CST::Node;
-	(*root)->type = CST::Type::String;
-	(*root)->beg = tks[0].beg + 1;
-	(*root)->len = tks[0].len - 2;
-	return 1;
-}
-
-size_t parse_number(const std::span<Token> &tks, CST::Node **root) {
-	*root = new CST::Node;
-	(*root)->type = CST::Type::Number;
-	(*root)->beg = tks[0].beg;
-	(*root)->len = tks[0].len;
-	return 1;
-}
-
-size_t parse_node(const std::span<Token> &tks, CST::Node **root);
-
-using Parser = size_t(const std::span<Token> &, CST::Node **);
-
-// parses a sequence of nodes with the given function
-size_t sequence_of(
-	Parser p, const std::span<Token> &tks, std::vector<CST::Node *> &cs
-) {
-	CST::Node *tmp = nullptr;
-	size_t read = p(tks, &tmp);
+#include <algorithm>
+#include <string_view>
+
+#include "profile.hpp"
+
+// Tokens of an already tokenized source, without the whitespace
+struct SpanTokens {
+	const std::span<Token> &tks;
+	std::string_view src;
+	size_t pos = 0;
+
+	bool peek(Token &tk) {
+		while (pos < tks.size() && is_space(tks[pos])) pos++;
+		if (pos >= tks.size()) return false;
+		tk = tks[pos];
+		return true;
+	}
 
-	if (read > 0) {
-		cs.push_back(tmp);
-		return read + sequence_of(p, tks.subspan(read), cs);
-	} else {
-		delete tmp;
-		return read;
+	bool next(Token &tk) {
+		if (!peek(tk)) return false;
+		pos++;
+		return true;
 	}
-}
 
-size_t parse_app(const std::span<Token> &tks, CST::Node **root) {
-	assert(tks[0].type == Token::Type::ParenOpen);
+	std::string_view text() const { return src; }
+};
+
+// Parser over any token source with peek, next and text. It keeps the open
+// applications on an explicit stack instead of recursing. Children of an
+// application are gathered on the pending stack while it's parsed, and then
+// moved to the tree together, so that siblings are adjacent.
+template<typename Tokens>
+struct Parser {
+	struct Frame {
+		CST::Node app;
+		size_t base; // of its children in pending
+	};
+
+	Tokens &tks;
+	CST &tree;
+	std::vector<CST::Node> &pending;
+	std::vector<Frame> &stack;
+
+	void error(size_t beg, const char *msg) {
+		tree.errors.push_back(SyntaxError {beg, msg});
+	}
 
-	// set current node (application)
-	CST::Node *cur = new CST::Node;
-	cur->beg = tks[0].beg;
-	cur->len = tks[0].len;
-	cur->type = CST::Type::App;
-	*root = cur;
+	CST::Node word(const Token &tk) {
+		CST::Node res {};
+		res.type = CST::Type::Symbol;
+		res.beg = tk.beg;
+		res.len = tk.len;
+		assert(tk.sym != UINT32_MAX);
+		res.sym = tk.sym;
+		return res;
+	}
 
-	// ( 1 2 3 ) -> 1 2 3
-	const std::span<Token> middle = tks.subspan(1, tks.size() - 2);
-	size_t read = sequence_of(parse_node, middle, cur->children);
+	CST::Node string(const Token &tk) {
+		CST::Node res {};
+		res.type = CST::Type::String;
+		res.beg = tk.beg + 1;
+		res.len = tk.len >= 2 ? tk.len - 2 : 0;
+		if (tk.len < 2 || tks.text()[tk.beg + tk.len - 1] != '"')
+			error(tk.beg, "Unterminated string");
+		return res;
+	}
 
-	assert(tks[read + 1].type == Token::Type::ParenClose);
-	return read + 2; // +2 for open and close parens
-}
-bool is_app(const std::span<Token> &tks) {
-	return tks[0].type == Token::Type::ParenOpen;
-}
+	CST::Node number(const Token &tk) {
+		CST::Node res {};
+		res.type = CST::Type::Number;
+		res.beg = tk.beg;
+		res.len = tk.len;
+		return res;
+	}
 
-bool is_number(const std::span<Token> &tks) {
-	return tks[0].type == Token::Type::Number;
-}
+	void open(const Token &tk) {
+		CST::Node app {};
+		app.beg = tk.beg;
+		app.len = tk.len;
+		app.type = CST::Type::App;
+		stack.push_back(Frame {app, pending.size()});
+	}
 
-bool is_word(const std::span<Token> &tks) {
-	switch (tks[0].type) {
-		case Token::Type::Plus:
-		case Token::Type::Minus:
-		case Token::Type::Star:
-		case Token::Type::Slash:
-		case Token::Type::Equal:
-		case Token::Type::Ampersand:
-		case Token::Type::Bang:
-		case Token::Type::Percent:
-		case Token::Type::Caret:
-		case Token::Type::BracketOpen:
-		case Token::Type::BracketClose:
-		case Token::Type::BraceOpen:
-		case Token::Type::BraceClose:
-		case Token::Type::LeftAngled:
-		case Token::Type::RightAngled:
-		case Token::Type::Word:
-		case Token::Type::Semicolon:
-		case Token::Type::Comma: return true;
-
-		case Token::Type::Number:
-		case Token::Type::String:
-		case Token::Type::SingleQuote:
-		case Token::Type::ParenOpen:
-		case Token::Type::ParenClose:
-		case Token::Type::Tabs:
-		case Token::Type::Spaces:
-		case Token::Type::Newline: return false;
+	// closes the innermost application, which ends at end
+	CST::Node close(size_t end) {
+		Frame f = stack.back();
+		stack.pop_back();
+		f.app.len = end - f.app.beg;
+
+		auto &nodes = tree.nodes;
+		f.app.first = (CST::Index)nodes.size();
+		f.app.count = (CST::Index)(pending.size() - f.base);
+		nodes.insert(nodes.end(), pending.begin() + (long)f.base, pending.end());
+		pending.resize(f.base);
+		return f.app;
 	}
-	return false;
-}
-size_t parse_node(const std::span<Token> &tks, CST::Node **root) {
-	size_t read = 0;
-
-	if (is_app(tks)) {
-		read = parse_app(tks, root);
-	} else if (is_number(tks)) {
-		read = parse_number(tks, root);
-	} else if (is_word(tks)) {
-		read = parse_word(tks, root);
-	} else if (tks[0].type == Token::Type::String) {
-		read = parse_string(tks, root);
-	} else if (tks[0].type == Token::Type::Newline || tks[0].type == Token::Type::Tabs || tks[0].type == Token::Type::Spaces) {
-		read = 1 + parse_node(tks.subspan(1), root);
+
+	// Parses the next node into res. Returns false if the input ended before
+	// any node started.
+	bool node(CST::Node &res) {
+		Token tk;
+		while (true) {
+			if (!tks.next(tk)) {
+				if (stack.empty()) return false;
+				// applications still open at the end of input are closed there
+				while (true) {
+					error(stack.back().app.beg, "Unclosed application");
+					res = close(tks.text().length());
+					if (stack.empty()) return true;
+					pending.push_back(res);
+				}
+			}
+
+			CST::Node done;
+			switch (tk.type) {
+				case Token::Type::ParenOpen: open(tk); continue;
+				case Token::Type::ParenClose:
+					if (stack.empty()) {
+						error(tk.beg, "Unexpected closing paren");
+						continue;
+					}
+					done = close(tk.beg + tk.len);
+					break;
+				case Token::Type::Number: done = number(tk); break;
+				case Token::Type::String: done = string(tk); break;
+				default:
+					if (!is_word(tk)) {
+						error(tk.beg, "Unexpected character");
+						continue;
+					}
+					done = word(tk);
+					break;
+			}
+
+			if (stack.empty()) {
+				res = done;
+				return true;
+			}
+			pending.push_back(done);
+		}
 	}
 
-	return read;
-}
+	// parses a single node as the root of the tree
+	bool root() {
+		CST::Node res {};
+		stack.clear();
+		pending.clear();
+		const bool found = node(res);
+		if (!found && tree.errors.empty())
+			error(tks.text().length(), "Expected an expression");
+		tree.root = (CST::Index)tree.nodes.size();
+		tree.nodes.push_back(res);
+		// unclosed applications are only found at the end
+		std::stable_sort(
+			tree.errors.begin(),
+			tree.errors.end(),
+			[](const SyntaxError &l, const SyntaxError &r) { return l.beg < r.beg; }
+		);
+		return found;
+	}
+};
 
-CST parse(const std::span<Token> &tks) {
+CST parse(const std::span<Token> &tks, std::string_view src) {
+	ProfileScope scope(Phase::Parse);
 	CST tree {};
-	size_t read = parse_node(tks, &tree.root);
-	tree.success = read == tks.size();
+	SpanTokens toks {tks, src};
+	std::vector<CST::Node> pending;
+	std::vector<Parser<SpanTokens>::Frame> stack;
+	Parser<SpanTokens> p {toks, tree, pending, stack};
+	Token rest;
+	if (p.root() && toks.peek(rest)) p.error(rest.beg, "Expected end of input");
 	return tree;
 }
+
+bool parse_form(TokenStream &tks, CST &tree) {
+	ProfileScope scope(Phase::Parse);
+	tree.nodes.clear();
+	tree.errors.clear();
+	tree.text.clear();
+	tks.discard();
+	Token tk;
+	if (!tks.peek(tk)) return false;
+	// reused between forms
+	thread_local std::vector<CST::Node> pending;
+	thread_local std::vector<Parser<TokenStream>::Frame> stack;
+	Parser<TokenStream> p {tks, tree, pending, stack};
+	p.root();
+	return true;
+}
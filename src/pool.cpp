@@ -0,0 +1,96 @@
+#include "pool.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// queue of the running thread, if it's a worker
+static thread_local const Pool *current = nullptr;
+static thread_local size_t current_index = 0;
+
+Pool::Pool(size_t threads) {
+	if (threads == 0) threads = 1;
+	for (size_t i = 0; i < threads; i++) queues.push_back(std::make_unique<Queue>());
+	// queue 0 belongs to the threads outside the pool
+	for (size_t i = 1; i < threads; i++) workers.emplace_back([this, i] { work(i); });
+}
+
+Pool::~Pool() {
+	{
+		std::lock_guard lock(sleep);
+		stop = true;
+	}
+	wake.notify_all();
+	for (auto &worker : workers) worker.join();
+}
+
+size_t Pool::self() const {
+	return current == this ? current_index : 0;
+}
+
+void Pool::spawn(Group &group, Func *func, void *arg) {
+	group.pending.fetch_add(1, std::memory_order_relaxed);
+	// counted before it's queued, so that it never goes below zero
+	queued.fetch_add(1, std::memory_order_release);
+	Queue &q = *queues[self()];
+	{
+		std::lock_guard lock(q.mutex);
+		q.tasks.push_back(Task {func, arg, &group});
+	}
+	if (!workers.empty()) {
+		// taking the lock orders this with a worker about to sleep
+		std::lock_guard lock(sleep);
+		wake.notify_one();
+	}
+}
+
+// Takes the newest task of its own queue, or else the oldest of another.
+bool Pool::take(size_t self, Task &task) {
+	if (queued.load(std::memory_order_acquire) == 0) return false;
+	for (size_t i = 0; i < queues.size(); i++) {
+		Queue &q = *queues[(self + i) % queues.size()];
+		std::lock_guard lock(q.mutex);
+		if (q.tasks.empty()) continue;
+		if (i == 0) {
+			task = q.tasks.back();
+			q.tasks.pop_back();
+		} else {
+			task = q.tasks.front();
+			q.tasks.pop_front();
+		}
+		queued.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+static void execute(const Pool::Func *func, void *arg, Pool::Group &group) {
+	func(arg);
+	group.pending.fetch_sub(1, std::memory_order_release);
+}
+
+void Pool::wait(Group &group) {
+	const size_t me = self();
+	Task task;
+	while (group.pending.load(std::memory_order_acquire) != 0) {
+		if (take(me, task))
+			execute(task.func, task.arg, *task.group);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void Pool::work(size_t self) {
+	current = this;
+	current_index = self;
+	Task task;
+	while (true) {
+		if (take(self, task)) {
+			execute(task.func, task.arg, *task.group);
+			continue;
+		}
+		std::unique_lock lock(sleep);
+		wake.wait(lock, [this] { return stop || queued.load() != 0; });
+		if (stop) return;
+	}
+}
@@ -0,0 +1,398 @@
+#include "profile.hpp"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "io.hpp"
+#include "symbol.hpp"
+
+bool profile_on = false;
+
+using Clock = std::chrono::steady_clock;
+
+static const char *const phase_names[phase_count] = {
+	"tokenize",
+	"parse",
+	"check",
+	"fold",
+	"compile",
+	"eval",
+	"print",
+};
+
+// events of the trace past this many are dropped, only counted
+static constexpr size_t max_events = 1 << 18;
+
+// how many hottest spans the printed report lists
+static constexpr size_t printed_spans = 10;
+
+// snippets of spans are cut to this many bytes
+static constexpr size_t snippet_len = 48;
+
+struct PhaseStat {
+	std::atomic<uint64_t> runs {0};
+	std::atomic<uint64_t> ns {0};
+	std::atomic<uint64_t> allocs {0};
+	std::atomic<uint64_t> bytes {0};
+};
+
+struct BuiltinStat {
+	std::atomic<uint64_t> calls {0};
+	std::atomic<uint64_t> ns {0};
+};
+
+// a phase run outside of any other, as a complete event of the trace
+struct Event {
+	Phase phase;
+	uint32_t tid;
+	uint64_t start_ns; // since the profile started
+	uint64_t dur_ns;
+};
+
+struct Span {
+	size_t len;
+	uint64_t calls;
+	uint64_t ns;
+};
+
+struct PlacedSpan {
+	std::string text;
+	uint64_t calls;
+	uint64_t ns;
+};
+
+// Phases and builtins are counted with atomics, as they are hit the most. The
+// rest takes the lock.
+struct Profile {
+	const Clock::time_point epoch = Clock::now();
+	PhaseStat phases[phase_count];
+	BuiltinStat builtins[builtin_count];
+
+	std::mutex mutex;
+	std::vector<Event> events;
+	size_t dropped_events = 0;
+	// by address in a source still being evaluated
+	std::unordered_map<const char *, Span> pending;
+	// by file, line and column
+	std::map<std::tuple<std::string, size_t, size_t>, PlacedSpan> spans;
+};
+
+static Profile &prof() {
+	static Profile p;
+	return p;
+}
+
+// of the calling thread, so that scopes on other threads don't count them
+static thread_local uint64_t thread_allocs = 0;
+static thread_local uint64_t thread_alloc_bytes = 0;
+static thread_local ProfileScope *current_scope = nullptr;
+
+void profile_alloc(size_t bytes) {
+	thread_allocs++;
+	thread_alloc_bytes += bytes;
+}
+
+static uint32_t thread_number() {
+	static std::atomic<uint32_t> next {0};
+	thread_local uint32_t n = next.fetch_add(1, std::memory_order_relaxed);
+	return n;
+}
+
+static uint64_t ns_between(Clock::time_point a, Clock::time_point b) {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count();
+}
+
+void ProfileScope::begin(Phase phase) {
+	active = true;
+	this->phase = phase;
+	parent = current_scope;
+	current_scope = this;
+	start_allocs = thread_allocs;
+	start_bytes = thread_alloc_bytes;
+	start = Clock::now();
+}
+
+void ProfileScope::end() {
+	const auto stop = Clock::now();
+	const uint64_t ns = ns_between(start, stop);
+	const uint64_t allocs = thread_allocs - start_allocs;
+	const uint64_t bytes = thread_alloc_bytes - start_bytes;
+
+	auto &p = prof();
+	auto &st = p.phases[(size_t)phase];
+	st.runs.fetch_add(1, std::memory_order_relaxed);
+	st.ns.fetch_add(ns - std::min(ns, nested_ns), std::memory_order_relaxed);
+	st.allocs.fetch_add(allocs - std::min(allocs, nested_allocs), std::memory_order_relaxed);
+	st.bytes.fetch_add(bytes - std::min(bytes, nested_bytes), std::memory_order_relaxed);
+
+	current_scope = parent;
+	if (parent != nullptr) {
+		parent->nested_ns += ns;
+		parent->nested_allocs += allocs;
+		parent->nested_bytes += bytes;
+		return;
+	}
+	// nested phases, such as lexing each token, would flood the trace
+	std::lock_guard lock(p.mutex);
+	if (p.events.size() < max_events)
+		p.events.push_back(Event {phase, thread_number(), ns_between(p.epoch, start), ns});
+	else
+		p.dropped_events++;
+}
+
+void profile_apply(SymbolId func, const char *span, size_t len, uint64_t ns) {
+	auto &p = prof();
+	if (is_builtin(func)) {
+		p.builtins[func].calls.fetch_add(1, std::memory_order_relaxed);
+		p.builtins[func].ns.fetch_add(ns, std::memory_order_relaxed);
+	}
+	if (span == nullptr) return;
+	std::lock_guard lock(p.mutex);
+	auto &s = p.pending[span];
+	s.len = len;
+	s.calls++;
+	s.ns += ns;
+}
+
+// the text of a span on one line, cut short if long
+static std::string snippet(std::string_view text) {
+	std::string res(text.substr(0, snippet_len));
+	for (auto &c : res)
+		if (c == '\n' || c == '\t' || c == '\r') c = ' ';
+	if (text.size() > snippet_len) res += "...";
+	return res;
+}
+
+void profile_spans(
+	std::string_view file, std::string_view text, size_t line, size_t column
+) {
+	if (!profiling()) return;
+	auto &p = prof();
+	std::lock_guard lock(p.mutex);
+	if (p.pending.empty()) return;
+
+	std::vector<size_t> newlines;
+	for (size_t i = 0; i < text.size(); i++)
+		if (text[i] == '\n') newlines.push_back(i);
+
+	const char *beg = text.data(), *end = text.data() + text.size();
+	for (auto it = p.pending.begin(); it != p.pending.end();) {
+		if (it->first < beg || it->first >= end) {
+			it++;
+			continue;
+		}
+		const size_t off = (size_t)(it->first - beg);
+		const auto nl = std::lower_bound(newlines.begin(), newlines.end(), off);
+		const size_t lines = (size_t)(nl - newlines.begin());
+		const size_t col = lines == 0 ? off + column : off - newlines[lines - 1];
+		auto &placed = p.spans[{std::string(file), line + lines, col}];
+		if (placed.calls == 0) placed.text = snippet(text.substr(off, it->second.len));
+		placed.calls += it->second.calls;
+		placed.ns += it->second.ns;
+		it = p.pending.erase(it);
+	}
+}
+
+// in bytes, of the resident set at its largest
+static size_t peak_memory() {
+	struct rusage ru {};
+	getrusage(RUSAGE_SELF, &ru);
+	return (size_t)ru.ru_maxrss * 1024;
+}
+
+using SpanEntry = std::pair<const std::tuple<std::string, size_t, size_t> *, const PlacedSpan *>;
+
+// hottest first
+static std::vector<SpanEntry> sorted_spans(const Profile &p) {
+	std::vector<SpanEntry> res;
+	for (auto &[where, span] : p.spans) res.emplace_back(&where, &span);
+	std::stable_sort(res.begin(), res.end(), [](const SpanEntry &a, const SpanEntry &b) {
+		return a.second->ns > b.second->ns;
+	});
+	return res;
+}
+
+static double ms(uint64_t ns) { return (double)ns / 1e6; }
+
+void print_profile() {
+	auto &p = prof();
+	print_fmt("; profile: phases, without the phases nested in them\n");
+	for (size_t i = 0; i < phase_count; i++) {
+		const auto &st = p.phases[i];
+		const uint64_t runs = st.runs.load(std::memory_order_relaxed);
+		if (runs == 0) continue;
+		print_fmt(
+			";   %-9s %10" PRIu64 " runs %12.3f ms %12" PRIu64 " allocs %14" PRIu64 " bytes\n",
+			phase_names[i],
+			runs,
+			ms(st.ns.load(std::memory_order_relaxed)),
+			st.allocs.load(std::memory_order_relaxed),
+			st.bytes.load(std::memory_order_relaxed)
+		);
+	}
+
+	print_fmt("; profile: builtins\n");
+	for (SymbolId f = 0; f < builtin_count; f++) {
+		const uint64_t calls = p.builtins[f].calls.load(std::memory_order_relaxed);
+		if (calls == 0) continue;
+		const uint64_t ns = p.builtins[f].ns.load(std::memory_order_relaxed);
+		const auto name = symbol_name(f);
+		print_fmt(
+			";   %-9.*s %10" PRIu64 " calls %11.3f ms %10.1f ns/call\n",
+			(int)name.size(),
+			name.data(),
+			calls,
+			ms(ns),
+			(double)ns / (double)calls
+		);
+	}
+
+	std::lock_guard lock(p.mutex);
+	const auto spans = sorted_spans(p);
+	// the VM doesn't record them
+	if (!spans.empty()) print_fmt("; profile: hottest spans\n");
+	for (size_t i = 0; i < std::min(spans.size(), printed_spans); i++) {
+		const auto &[file, line, col] = *spans[i].first;
+		print_fmt(
+			";   %s:%zu:%zu %10" PRIu64 " calls %11.3f ms  %s\n",
+			file.empty() ? "<input>" : file.c_str(),
+			line,
+			col,
+			spans[i].second->calls,
+			ms(spans[i].second->ns),
+			spans[i].second->text.c_str()
+		);
+	}
+	print_fmt("; profile: peak memory %zu bytes\n", peak_memory());
+}
+
+static void json_str(std::string &out, std::string_view s) {
+	out += '"';
+	for (const char ch : s) {
+		const auto c = (unsigned char)ch;
+		switch (c) {
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (c < 0x20) {
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", c);
+					out += buf;
+				} else
+					out += ch;
+		}
+	}
+	out += '"';
+}
+
+static void json_num(std::string &out, const char *key, uint64_t n) {
+	out += '"';
+	out += key;
+	out += "\": ";
+	out += std::to_string(n);
+}
+
+bool write_profile(const std::string &path) {
+	auto &p = prof();
+	std::string out = "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+	std::lock_guard lock(p.mutex);
+
+	// timestamps of the trace format are in microseconds
+	char buf[128];
+	for (size_t i = 0; i < p.events.size(); i++) {
+		const auto &e = p.events[i];
+		snprintf(
+			buf,
+			sizeof(buf),
+			"%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, "
+			"\"dur\": %.3f}",
+			i == 0 ? "" : ",",
+			phase_names[(size_t)e.phase],
+			e.tid,
+			(double)e.start_ns / 1e3,
+			(double)e.dur_ns / 1e3
+		);
+		out += buf;
+	}
+
+	out += "],\n\"profile\": {\"phases\": [";
+	bool first = true;
+	for (size_t i = 0; i < phase_count; i++) {
+		const auto &st = p.phases[i];
+		const uint64_t runs = st.runs.load(std::memory_order_relaxed);
+		if (runs == 0) continue;
+		out += first ? "\n{\"name\": " : ",\n{\"name\": ";
+		first = false;
+		json_str(out, phase_names[i]);
+		out += ", ";
+		json_num(out, "runs", runs);
+		out += ", ";
+		json_num(out, "ns", st.ns.load(std::memory_order_relaxed));
+		out += ", ";
+		json_num(out, "allocs", st.allocs.load(std::memory_order_relaxed));
+		out += ", ";
+		json_num(out, "alloc_bytes", st.bytes.load(std::memory_order_relaxed));
+		out += "}";
+	}
+
+	out += "],\n\"builtins\": [";
+	first = true;
+	for (SymbolId f = 0; f < builtin_count; f++) {
+		const uint64_t calls = p.builtins[f].calls.load(std::memory_order_relaxed);
+		if (calls == 0) continue;
+		out += first ? "\n{\"name\": " : ",\n{\"name\": ";
+		first = false;
+		json_str(out, symbol_name(f));
+		out += ", ";
+		json_num(out, "calls", calls);
+		out += ", ";
+		json_num(out, "ns", p.builtins[f].ns.load(std::memory_order_relaxed));
+		out += "}";
+	}
+
+	out += "],\n\"spans\": [";
+	first = true;
+	for (auto &[where, span] : sorted_spans(p)) {
+		const auto &[file, line, col] = *where;
+		out += first ? "\n{\"file\": " : ",\n{\"file\": ";
+		first = false;
+		json_str(out, file);
+		out += ", ";
+		json_num(out, "line", line);
+		out += ", ";
+		json_num(out, "col", col);
+		out += ", \"text\": ";
+		json_str(out, span->text);
+		out += ", ";
+		json_num(out, "calls", span->calls);
+		out += ", ";
+		json_num(out, "ns", span->ns);
+		out += "}";
+	}
+
+	out += "],\n";
+	json_num(out, "dropped_events", p.dropped_events);
+	out += ", ";
+	json_num(out, "peak_memory_bytes", peak_memory());
+	out += "}}\n";
+
+	std::ofstream file(path, std::ios::binary);
+	file << out;
+	return (bool)file;
+}
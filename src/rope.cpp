@@ -0,0 +1,28 @@
+#include "rope.hpp"
+
+#include <string>
+#include <string_view>
+
+Rope::Rope(std::string_view text) : len {text.size()}, text {text} {}
+
+Rope::Rope(const Rope *left, const Rope *right)
+: len {left->len + right->len} {
+	if (len < min_concat) {
+		text.reserve(len);
+		left->for_each_piece([this](std::string_view s) { text += s; });
+		right->for_each_piece([this](std::string_view s) { text += s; });
+		return;
+	}
+	this->left = left;
+	this->right = right;
+}
+
+std::string_view Rope::flat() const {
+	if (is_flat()) return text;
+	std::string res;
+	res.reserve(len);
+	for_each_piece([&res](std::string_view s) { res += s; });
+	text = std::move(res);
+	flattened = true;
+	return text;
+}
@@ -0,0 +1,188 @@
+#include "scan.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#	define ALUAR_SCAN_X86
+#	include <immintrin.h>
+#endif
+
+using Scanner = size_t (*)(const char *, size_t);
+
+template<ScanClass C>
+static bool in_class(char c) {
+	switch (C) {
+		case ScanClass::Space: return c == ' ';
+		case ScanClass::Tab: return c == '\t';
+		case ScanClass::Alpha:
+			return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z');
+		case ScanClass::Digit: return '0' <= c && c <= '9';
+		case ScanClass::NotQuote: return c != '"';
+	}
+	return false;
+}
+
+template<ScanClass C>
+static size_t scan_scalar(const char *p, size_t n) {
+	size_t i = 0;
+	while (i < n && in_class<C>(p[i])) i++;
+	return i;
+}
+
+// Most runs are short words and single spaces, for which setting up vectors
+// costs more than it saves, so the first bytes are always scanned one by one.
+const size_t scalar_prefix = 8;
+
+template<ScanClass C>
+static size_t scan_prefix(const char *p, size_t n) {
+	return scan_scalar<C>(p, n < scalar_prefix ? n : scalar_prefix);
+}
+
+#ifdef ALUAR_SCAN_X86
+
+// Bytes are compared as signed, so anything above 0x7f is below every bound
+// and falls out of the ranges.
+template<ScanClass C>
+static __m128i classify_sse2(__m128i v) {
+	switch (C) {
+		case ScanClass::Space: return _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+		case ScanClass::Tab: return _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'));
+		case ScanClass::Alpha: {
+			// setting bit 5 folds uppercase into lowercase
+			const __m128i low = _mm_or_si128(v, _mm_set1_epi8(0x20));
+			return _mm_and_si128(
+				_mm_cmpgt_epi8(low, _mm_set1_epi8('a' - 1)),
+				_mm_cmplt_epi8(low, _mm_set1_epi8('z' + 1))
+			);
+		}
+		case ScanClass::Digit:
+			return _mm_and_si128(
+				_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+				_mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1))
+			);
+		case ScanClass::NotQuote:
+			return _mm_xor_si128(
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_set1_epi8(-1)
+			);
+	}
+	return _mm_setzero_si128();
+}
+
+template<ScanClass C>
+static size_t scan_sse2(const char *p, size_t n) {
+	size_t i = scan_prefix<C>(p, n);
+	if (i < scalar_prefix) return i;
+	for (; i + 16 <= n; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		const auto mask = (uint32_t)_mm_movemask_epi8(classify_sse2<C>(v));
+		if (mask != 0xffff) return i + (size_t)__builtin_ctz(~mask);
+	}
+	return i + scan_scalar<C>(p + i, n - i);
+}
+
+template<ScanClass C>
+__attribute__((target("avx2"))) static __m256i classify_avx2(__m256i v) {
+	switch (C) {
+		case ScanClass::Space: return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+		case ScanClass::Tab: return _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'));
+		case ScanClass::Alpha: {
+			const __m256i low = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+			return _mm256_and_si256(
+				_mm256_cmpgt_epi8(low, _mm256_set1_epi8('a' - 1)),
+				_mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), low)
+			);
+		}
+		case ScanClass::Digit:
+			return _mm256_and_si256(
+				_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+				_mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v)
+			);
+		case ScanClass::NotQuote:
+			return _mm256_xor_si256(
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_set1_epi8(-1)
+			);
+	}
+	return _mm256_setzero_si256();
+}
+
+template<ScanClass C>
+__attribute__((target("avx2"))) static size_t scan_avx2(const char *p, size_t n) {
+	size_t i = scan_prefix<C>(p, n);
+	if (i < scalar_prefix) return i;
+	for (; i + 32 <= n; i += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		const auto mask = (uint32_t)_mm256_movemask_epi8(classify_avx2<C>(v));
+		if (mask != 0xffffffff) return i + (size_t)__builtin_ctz(~mask);
+	}
+	return i + scan_sse2<C>(p + i, n - i);
+}
+
+#endif
+
+// indexed by ScanClass
+struct Scanners {
+	Scanner fn[5];
+};
+
+template<template<ScanClass> typename Impl>
+static constexpr Scanners scanners_of() {
+	return Scanners {{
+		Impl<ScanClass::Space>::run,
+		Impl<ScanClass::Tab>::run,
+		Impl<ScanClass::Alpha>::run,
+		Impl<ScanClass::Digit>::run,
+		Impl<ScanClass::NotQuote>::run,
+	}};
+}
+
+template<ScanClass C>
+struct Scalar {
+	static size_t run(const char *p, size_t n) { return scan_scalar<C>(p, n); }
+};
+
+#ifdef ALUAR_SCAN_X86
+template<ScanClass C>
+struct SSE2 {
+	static size_t run(const char *p, size_t n) { return scan_sse2<C>(p, n); }
+};
+
+template<ScanClass C>
+struct AVX2 {
+	static size_t run(const char *p, size_t n) { return scan_avx2<C>(p, n); }
+};
+#endif
+
+static ScanIsa best_isa() {
+#ifdef ALUAR_SCAN_X86
+	if (__builtin_cpu_supports("avx2")) return ScanIsa::AVX2;
+	if (__builtin_cpu_supports("sse2")) return ScanIsa::SSE2;
+#endif
+	return ScanIsa::Scalar;
+}
+
+static Scanners scanners_for(ScanIsa isa) {
+	switch (isa) {
+#ifdef ALUAR_SCAN_X86
+		case ScanIsa::AVX2: return scanners_of<AVX2>();
+		case ScanIsa::SSE2: return scanners_of<SSE2>();
+#endif
+		default: return scanners_of<Scalar>();
+	}
+}
+
+static ScanIsa isa = best_isa();
+static Scanners scanners = scanners_for(isa);
+
+size_t scan(ScanClass cls, std::string_view src) {
+	return scanners.fn[(size_t)cls](src.data(), src.length());
+}
+
+ScanIsa scan_isa() { return isa; }
+
+void set_scan_isa(ScanIsa want) {
+	if (want > best_isa()) want = best_isa();
+	isa = want;
+	scanners = scanners_for(isa);
+}
@@ -0,0 +1,165 @@
+#include "symbol.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// same order as the Builtin enum
+static const char *const builtin_names[builtin_count] = {
+	"add",
+	"sub",
+	"mul",
+	"div",
+	"shl",
+	"shr",
+	"cat",
+	"put",
+	"and",
+	"or",
+	"xor",
+	"not",
+	"println",
+};
+
+// longest string kept inside of a std::string instead of on the heap
+static constexpr size_t sso_capacity = std::string().capacity();
+
+struct LocalSymbols;
+
+// Files may be parsed on several threads, so lookups share a lock and only
+// new names take it exclusively. Each thread looks in a cache of its own
+// first, see LocalSymbols.
+struct SymbolTable {
+	std::shared_mutex mutex;
+	std::deque<std::string> names; // stable storage for the keys of ids
+	std::unordered_map<std::string_view, SymbolId> ids;
+	size_t name_bytes = 0; // owned by names, outside of the strings themselves
+
+	// counters of the threads that interned, and of those that exited
+	std::mutex locals_mutex;
+	std::vector<const LocalSymbols *> locals;
+	size_t exited_references = 0;
+	size_t exited_string_bytes = 0;
+
+	SymbolTable() {
+		for (auto name : builtin_names) insert(name);
+	}
+
+	SymbolId insert(std::string_view name) {
+		const auto sym = (SymbolId)names.size();
+		names.emplace_back(name);
+		if (names.back().capacity() > sso_capacity) name_bytes += names.back().capacity() + 1;
+		ids.emplace(names.back(), sym);
+		return sym;
+	}
+};
+
+// Never destroyed, threads may still intern or exit after static destruction.
+static SymbolTable &table() {
+	static SymbolTable &tab = *new SymbolTable;
+	return tab;
+}
+
+// Symbols recently interned by a thread, found without the lock. Names point
+// into the table, where they never change nor move. The counters are only
+// written by their thread, atomically so that stats may read them.
+struct LocalSymbols {
+	struct Entry {
+		std::string_view name;
+		SymbolId id;
+	};
+
+	static constexpr size_t size = 256;
+	Entry recent[size] {};
+	std::atomic<size_t> references {0};
+	std::atomic<size_t> string_bytes {0};
+
+	LocalSymbols() {
+		auto &tab = table();
+		std::lock_guard lock(tab.locals_mutex);
+		tab.locals.push_back(this);
+	}
+
+	~LocalSymbols() {
+		auto &tab = table();
+		std::lock_guard lock(tab.locals_mutex);
+		tab.exited_references += references.load(std::memory_order_relaxed);
+		tab.exited_string_bytes += string_bytes.load(std::memory_order_relaxed);
+		std::erase(tab.locals, this);
+	}
+
+	// FNV-1a, a collision only costs a lookup in the table
+	static size_t slot(std::string_view name) {
+		uint32_t h = 2166136261u;
+		for (unsigned char c : name) h = (h ^ c) * 16777619u;
+		return (h ^ (h >> 16)) % size;
+	}
+
+	void count(std::string_view name) {
+		const size_t bytes =
+			sizeof(std::string) + (name.size() > sso_capacity ? name.size() + 1 : 0);
+		references.store(references.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		string_bytes.store(string_bytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+	}
+};
+
+static SymbolId lookup(SymbolTable &tab, std::string_view name) {
+	{
+		std::shared_lock lock(tab.mutex);
+		auto it = tab.ids.find(name);
+		if (it != tab.ids.end()) return it->second;
+	}
+	std::unique_lock lock(tab.mutex);
+	// it may have been inserted since the lookup
+	auto it = tab.ids.find(name);
+	if (it != tab.ids.end()) return it->second;
+	return tab.insert(name);
+}
+
+SymbolId intern(std::string_view name) {
+	auto &tab = table();
+	thread_local LocalSymbols local;
+	local.count(name);
+	auto &entry = local.recent[LocalSymbols::slot(name)];
+	if (entry.name.data() != nullptr && entry.name == name) return entry.id;
+
+	const SymbolId sym = lookup(tab, name);
+	std::shared_lock lock(tab.mutex);
+	entry = LocalSymbols::Entry {tab.names[sym], sym};
+	return sym;
+}
+
+std::string_view symbol_name(SymbolId sym) {
+	auto &tab = table();
+	std::shared_lock lock(tab.mutex);
+	return tab.names[sym];
+}
+
+SymbolStats symbol_stats() {
+	auto &tab = table();
+	SymbolStats st {};
+	{
+		std::lock_guard lock(tab.locals_mutex);
+		st.references = tab.exited_references;
+		st.string_bytes = tab.exited_string_bytes;
+		for (auto local : tab.locals) {
+			st.references += local->references.load(std::memory_order_relaxed);
+			st.string_bytes += local->string_bytes.load(std::memory_order_relaxed);
+		}
+	}
+	std::shared_lock lock(tab.mutex);
+	st.unique = tab.names.size();
+	// each entry of the index is a node holding the key, the id and a link,
+	// plus its bucket
+	const size_t entry = sizeof(std::string_view) + sizeof(SymbolId) + 2 * sizeof(void *);
+	st.table_bytes = st.unique * (sizeof(std::string) + entry) + tab.name_bytes;
+	const size_t used = st.table_bytes + st.references * sizeof(SymbolId);
+	st.saved_bytes = st.string_bytes > used ? st.string_bytes - used : 0;
+	return st;
+}
@@ -0,0 +1,115 @@
+#include "types.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parse.hpp"
+#include "profile.hpp"
+#include "symbol.hpp"
+
+// What is known of the value of a node before running it. Errors abort
+// evaluation, so they have no type of their own.
+enum class StaticType : uint8_t {
+	Any, // of nodes already reported, accepted anywhere to avoid cascades
+	Number,
+	String,
+	Symbol,
+	Nil,
+};
+
+struct Signature {
+	StaticType param; // of every argument
+	uint8_t min;
+	uint8_t max;
+	StaticType result;
+};
+
+static constexpr uint8_t variadic = UINT8_MAX;
+
+// indexed by builtin slot, like the builtins
+static const Signature signatures[builtin_count] = {
+	{StaticType::Number, 0, variadic, StaticType::Number}, // add
+	{StaticType::Number, 0, variadic, StaticType::Number}, // sub
+	{StaticType::Number, 0, variadic, StaticType::Number}, // mul
+	{StaticType::Number, 0, variadic, StaticType::Number}, // div
+	{StaticType::Number, 2, 2, StaticType::Number},        // shl
+	{StaticType::Number, 2, 2, StaticType::Number},        // shr
+	{StaticType::String, 0, variadic, StaticType::String}, // cat
+	{StaticType::String, 1, 1, StaticType::Nil},           // put
+	{StaticType::Number, 0, variadic, StaticType::Number}, // and
+	{StaticType::Number, 0, variadic, StaticType::Number}, // or
+	{StaticType::Number, 0, variadic, StaticType::Number}, // xor
+	{StaticType::Number, 1, 1, StaticType::Number},        // not
+	{StaticType::String, 1, 1, StaticType::String},        // println
+};
+
+static const char *expected(StaticType type) {
+	return type == StaticType::Number ? "Type Error: expected Number"
+	                                  : "Type Error: expected String";
+}
+
+bool check_types(CST &tree, std::string_view src) {
+	ProfileScope scope(Phase::Check);
+	if (!tree.success()) return false;
+
+	// children come before their parents, so one pass sees all of them
+	std::vector<StaticType> types(tree.nodes.size());
+	for (size_t i = 0; i < tree.nodes.size(); i++) {
+		auto &node = tree.nodes[i];
+		switch (node.type) {
+			case CST::Type::Number: types[i] = StaticType::Number; continue;
+			case CST::Type::String: types[i] = StaticType::String; continue;
+			case CST::Type::Symbol: types[i] = StaticType::Symbol; continue;
+			case CST::Type::App: break;
+		}
+
+		node.typed = false;
+		types[i] = StaticType::Any;
+		if (node.count == 0) {
+			tree.errors.push_back(SyntaxError {node.beg, "Empty application"});
+			continue;
+		}
+		const auto &head = tree.nodes[node.first];
+		if (head.type != CST::Type::Symbol || !is_builtin(head.sym)) {
+			std::string err = "Unknown function \"";
+			err += tree.text_of(head, src);
+			err += "\"";
+			tree.errors.push_back(SyntaxError {head.beg, std::move(err)});
+			continue;
+		}
+
+		const Signature &sig = signatures[head.sym];
+		const size_t argc = node.count - 1;
+		if (argc < sig.min || (sig.max != variadic && argc > sig.max)) {
+			tree.errors.push_back(
+				SyntaxError {node.beg, "Type Error: wrong number of arguments"}
+			);
+			continue;
+		}
+		bool typed = true;
+		for (size_t c = node.first + 1; c < node.first + node.count; c++) {
+			if (types[c] == sig.param) continue;
+			typed = false;
+			if (types[c] == StaticType::Any) continue;
+			// the text of synthetic literals is not in the source
+			const auto &arg = tree.nodes[c];
+			tree.errors.push_back(
+				SyntaxError {arg.synthetic ? node.beg : arg.beg, expected(sig.param)}
+			);
+			break;
+		}
+		node.typed = typed;
+		// arguments already reported don't make the result unknown
+		types[i] = sig.result;
+	}
+
+	std::stable_sort(
+		tree.errors.begin(),
+		tree.errors.end(),
+		[](const SyntaxError &a, const SyntaxError &b) { return a.beg < b.beg; }
+	);
+	return tree.success();
+}
@@ -0,0 +1,263 @@
+#include "vm.hpp"
+
+#include <charconv>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "bigint.hpp"
+#include "eval.hpp"
+#include "parse.hpp"
+#include "profile.hpp"
+#include "rope.hpp"
+#include "symbol.hpp"
+
+using Op = Bytecode::Op;
+
+struct Compiler {
+	const CST &tree;
+	std::string_view src;
+	Bytecode &out;
+	std::unordered_map<int64_t, uint32_t> num_ids;
+	std::unordered_map<std::string_view, uint32_t> lit_ids;
+	size_t depth = 0;
+
+	void emit(Op op, uint32_t arg, uint8_t slot = 0) {
+		out.code.push_back(Bytecode::Instr {op, slot, arg});
+	}
+
+	void push() {
+		depth++;
+		if (depth > out.max_stack) out.max_stack = depth;
+	}
+
+	uint32_t num(int64_t n) {
+		auto it = num_ids.find(n);
+		if (it != num_ids.end()) return it->second;
+		const auto id = (uint32_t)out.nums.size();
+		out.nums.push_back(n);
+		num_ids.emplace(n, id);
+		return id;
+	}
+
+	uint32_t lit(std::string_view s) {
+		auto it = lit_ids.find(s);
+		if (it != lit_ids.end()) return it->second;
+		const auto id = (uint32_t)out.lits.size();
+		out.lits.emplace_back(s);
+		// keyed by the source text, which outlives the compiler
+		lit_ids.emplace(s, id);
+		return id;
+	}
+
+	void fail(std::string err) {
+		emit(Op::Fail, (uint32_t)out.strs.size());
+		out.strs.push_back(std::move(err));
+		push();
+	}
+
+	// An application whose arguments are being compiled
+	struct Pending {
+		const CST::Node *app;
+		size_t base;   // stack depth before its arguments
+		uint32_t next; // child being compiled
+	};
+
+	// Emits the instructions of an application, leaving the first argument
+	// to compile after pushing it, or nullptr when nothing is left to do
+	const CST::Node *app(const CST::Node &node, std::vector<Pending> &apps) {
+		const auto children = tree.children(node);
+		if (children.size() == 0) {
+			fail("Empty application");
+			return nullptr;
+		}
+
+		const CST::Node &func_node = children[0];
+		if (func_node.type != CST::Type::Symbol || !is_builtin(func_node.sym)) {
+			std::string err = "Unknown function \"";
+			err += src.substr(func_node.beg, func_node.len);
+			err += "\"";
+			fail(std::move(err));
+			return nullptr;
+		}
+
+		apps.push_back(Pending {&node, depth, 1});
+		return children.size() > 1 ? &children[1] : nullptr;
+	}
+
+	void leaf(const CST::Node &node) {
+		switch (node.type) {
+			case CST::Type::App: break;
+			case CST::Type::Number: {
+				const auto repr = tree.text_of(node, src);
+				int64_t n = 0;
+				const auto [p, ec] = std::from_chars(repr.data(), repr.data() + repr.size(), n);
+				if (ec == std::errc::result_out_of_range) {
+					BigInt big;
+					BigInt::parse(repr, big);
+					emit(Op::Big, (uint32_t)out.bigs.size());
+					out.bigs.push_back(std::move(big));
+				} else {
+					emit(Op::Num, num(n));
+				}
+				push();
+				break;
+			}
+			case CST::Type::Symbol:
+				emit(Op::Sym, node.sym);
+				push();
+				break;
+			case CST::Type::String:
+				emit(Op::Str, lit(tree.text_of(node, src)));
+				push();
+				break;
+		}
+	}
+
+	static Op call_op(const CST::Node &app, SymbolId sym) {
+		if (!app.typed) return Op::Call;
+		if (app.count == 3) switch ((Builtin)sym) {
+				case Builtin::Add: return Op::Add;
+				case Builtin::Sub: return Op::Sub;
+				case Builtin::Mul: return Op::Mul;
+				default: break;
+			}
+		return Op::TypedCall;
+	}
+
+	// walks the tree with a stack of its own, as it may be nested deeper than
+	// the native stack allows
+	void expr(const CST::Node &root) {
+		std::vector<Pending> apps;
+		const CST::Node *next = &root;
+		while (true) {
+			while (next != nullptr) {
+				if (next->type == CST::Type::App) next = app(*next, apps);
+				else {
+					leaf(*next);
+					next = nullptr;
+				}
+			}
+
+			if (apps.empty()) return;
+			Pending &pending = apps.back();
+			if (++pending.next < pending.app->count) {
+				next = &tree.nodes[pending.app->first + pending.next];
+				continue;
+			}
+			const auto sym = tree.nodes[pending.app->first].sym;
+			emit(call_op(*pending.app, sym), (uint32_t)(depth - pending.base), (uint8_t)sym);
+			depth = pending.base;
+			push();
+			apps.pop_back();
+		}
+	}
+};
+
+Bytecode compile(const CST &tree, std::string_view src) {
+	ProfileScope scope(Phase::Compile);
+	Bytecode out {};
+	Compiler c {tree, src, out, {}, {}};
+	c.expr(tree.root_node());
+	c.emit(Op::Ret, 0);
+	return out;
+}
+
+// Applies a typed add, sub or mul to the two numbers on top of the stack,
+// falling back to the builtin once they don't fit 64 bits
+template<typename Small>
+static Value *arith(Value *base, Value *sp, uint8_t slot, Small small) {
+	sp--;
+	Value &a = sp[-1];
+	int64_t res;
+	if (a.type == Value::Type::Number && sp->type == Value::Type::Number
+	    && !small(a.num, sp->num, &res)) {
+		a.num = res;
+		return sp;
+	}
+	a = typed_builtins[slot](std::span(sp - 1, 2));
+	collect_values(std::span(base, sp));
+	return sp;
+}
+
+// Applications of builtins are timed only when profiling, by an instance of
+// its own so that the other pays nothing for it
+template<bool Profile>
+static Value execute(const Bytecode &code) {
+	// reused between runs to keep them allocation free
+	thread_local std::vector<Value> stack;
+	if (stack.size() < code.max_stack) stack.resize(code.max_stack);
+
+	Value *sp = stack.data(); // one past the top
+	const Bytecode::Instr *ip = code.code.data();
+
+	while (true) {
+		const Bytecode::Instr in = *ip++;
+		ProfileClock::time_point started;
+		if constexpr (Profile)
+			if (in.op >= Op::Call && in.op <= Op::Mul) started = ProfileClock::now();
+		switch (in.op) {
+			case Op::Num: *sp++ = value_num(code.nums[in.arg]); break;
+			case Op::Str: *sp++ = value_rope(&code.lits[in.arg]); break;
+			case Op::Big: {
+				Value val;
+				val.type = Value::Type::BigNumber;
+				val.big = &code.bigs[in.arg];
+				*sp++ = val;
+				break;
+			}
+			case Op::Sym: *sp++ = value_sym(in.arg); break;
+			case Op::Call: {
+				sp -= in.arg;
+				const Value res = builtins[in.slot](std::span(sp, in.arg));
+				if (res.type == Value::Type::Error) return res;
+				*sp++ = res;
+				collect_values(std::span(stack.data(), sp));
+				break;
+			}
+			case Op::TypedCall: {
+				sp -= in.arg;
+				const Value res = typed_builtins[in.slot](std::span(sp, in.arg));
+				if (res.type == Value::Type::Error) return res;
+				*sp++ = res;
+				collect_values(std::span(stack.data(), sp));
+				break;
+			}
+			case Op::Add:
+				sp = arith(stack.data(), sp, in.slot, [](int64_t a, int64_t b, int64_t *res) {
+					return __builtin_add_overflow(a, b, res);
+				});
+				break;
+			case Op::Sub:
+				sp = arith(stack.data(), sp, in.slot, [](int64_t a, int64_t b, int64_t *res) {
+					return __builtin_sub_overflow(a, b, res);
+				});
+				break;
+			case Op::Mul:
+				sp = arith(stack.data(), sp, in.slot, [](int64_t a, int64_t b, int64_t *res) {
+					return __builtin_mul_overflow(a, b, res);
+				});
+				break;
+			case Op::Fail: {
+				Value val;
+				val.type = Value::Type::Error;
+				val.str = &code.strs[in.arg];
+				return val;
+			}
+			case Op::Ret: return sp[-1];
+		}
+		// the bytecode keeps no spans, only builtins are counted
+		if constexpr (Profile)
+			if (in.op >= Op::Call && in.op <= Op::Mul)
+				profile_apply(in.slot, nullptr, 0, profile_ns_since(started));
+	}
+}
+
+Value run(const Bytecode &code) {
+	ProfileScope scope(Phase::Eval);
+	if (profiling()) [[unlikely]] return execute<true>(code);
+	return execute<false>(code);
+}
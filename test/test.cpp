@@ -0,0 +1,94 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "interpreter.hpp"
+#include "lex.hpp"
+#include "symbol.hpp"
+
+static int failures = 0;
+
+#define CHECK(COND)                                                            \
+	do {                                                                       \
+		if (!(COND)) {                                                         \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,   \
+			        #COND);                                                    \
+			failures++;                                                        \
+		}                                                                      \
+	} while (0)
+
+static const char operators[] = "+ - * / = & ! % ^ [ ] { } < > ; ,";
+
+// Every operator is interned under its own text, none with the id of a builtin
+static void test_operators_interned() {
+	std::string_view src = operators;
+	for (const Token &tk : tokenize(src)) {
+		if (is_space(tk)) continue;
+		CHECK(is_word(tk));
+		CHECK(tk.sym != UINT32_MAX);
+		CHECK(!is_builtin(tk.sym));
+		CHECK(symbol_name(tk.sym) == src.substr(tk.beg, tk.len));
+	}
+
+	// and so does the token stream
+	TokenStream stream(src);
+	Token tk;
+	size_t count = 0;
+	while (stream.next(tk)) {
+		CHECK(tk.sym == intern(stream.text().substr(tk.beg, tk.len)));
+		count++;
+	}
+	CHECK(count == 17);
+}
+
+static void check_unknown(Interpreter &interp, const char *src,
+                          const char *msg) {
+	Value val = interp.eval(src);
+	CHECK(val.type == Value::Type::Error);
+	CHECK(!interp.errors().empty()
+	      && interp.errors().front().msg == msg);
+	interp.reset();
+}
+
+static void check_number(Interpreter &interp, const char *src, int64_t num) {
+	Value val = interp.eval(src);
+	CHECK(val.type == Value::Type::Number && val.num == num);
+	interp.reset();
+}
+
+// Operators name no builtin, so applying one is an error on every path, while
+// the builtins still evaluate as before.
+static void test_operators_evaluate() {
+	Interpreter::Options variants[] = {
+		{},
+		{.vm = true},
+		{.fold = true},
+		{.vm = true, .fold = true},
+	};
+	for (auto opts : variants) {
+		Interpreter interp(opts);
+		check_unknown(interp, "(- 4 3)", "Unknown function \"-\"");
+		check_unknown(interp, "(+ 4 3)", "Unknown function \"+\"");
+		check_unknown(interp, "(sub 4 (* 1 3))", "Unknown function \"*\"");
+		check_number(interp, "(sub 4 3)", 1);
+		check_number(interp, "(add 4 3)", 7);
+		check_number(interp, "(div 8 (mul 2 2))", 2);
+	}
+
+	// without the type checker, the evaluators report it themselves
+	for (bool vm : {false, true}) {
+		Interpreter interp({.vm = vm, .typecheck = false});
+		Value val = interp.eval("(- 4 3)");
+		CHECK(val.type == Value::Type::Error);
+		check_number(interp, "(sub 4 3)", 1);
+	}
+}
+
+int main() {
+	test_operators_interned();
+	test_operators_evaluate();
+	if (failures) fprintf(stderr, "%d checks failed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}